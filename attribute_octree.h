@@ -0,0 +1,69 @@
+#ifndef _ATTRIBUTE_OCTREE_H_
+#define _ATTRIBUTE_OCTREE_H_
+
+#include <cstdint>
+#include <optional>
+#include <tuple>
+
+#include "octree.h"
+#include "payload_tree.h"
+
+// Occupancy plus typed per-region attributes (material ids, labels, colours).
+// Each attribute is a separate channel with its own PayloadTree, so queries
+// on occupancy or on one channel never touch the bytes of the others. A
+// channel collapses an octet only when all eight children hold equal values,
+// while occupancy keeps collapsing fully set octets as before. Unset regions
+// hold each channel's default-constructed value.
+template <typename LocationCode, typename MapWrapper, typename... Attributes>
+class AttributeOctreeBase
+{
+public:
+
+    using OctreeType = OctreeBase<LocationCode, MapWrapper>;
+    using LocationCodes = LocationCodesBase<LocationCode>;
+    using LocationCodeType = LocationCode;
+
+    template <size_t Channel>
+    using AttributeType = std::tuple_element_t<Channel, std::tuple<Attributes...>>;
+
+    template <size_t Channel>
+    using ChannelType = PayloadTree<LocationCode, AttributeType<Channel>, MapWrapper>;
+
+    AttributeOctreeBase();
+
+    // Sets the region and assigns a value on every channel
+    void set(LocationCode location_code, const Attributes&... values);
+
+    // Clears the region and resets every channel to its default
+    void clear(LocationCode location_code);
+
+    bool is_set(LocationCode location_code) const { return _octree.is_set(location_code); }
+
+    // Nullopt if the region holds differing values
+    template <size_t Channel>
+    std::optional<AttributeType<Channel>> get_attribute(LocationCode location_code) const
+    {
+        return std::get<Channel>(_channels).get(location_code);
+    }
+
+    // Assigns one channel without changing occupancy
+    template <size_t Channel>
+    void set_attribute(LocationCode location_code, const AttributeType<Channel>& value)
+    {
+        std::get<Channel>(_channels).set(location_code, value);
+    }
+
+    const OctreeType& get_octree() const { return _octree; }
+
+    template <size_t Channel>
+    const ChannelType<Channel>& get_channel() const { return std::get<Channel>(_channels); }
+
+private:
+
+    OctreeType _octree;
+    std::tuple<PayloadTree<LocationCode, Attributes, MapWrapper>...> _channels;
+};
+
+#include "attribute_octree.inl.h"
+
+#endif // _ATTRIBUTE_OCTREE_H_
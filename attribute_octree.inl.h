@@ -0,0 +1,30 @@
+#include "attribute_octree.h"
+
+template <typename LocationCode, typename MapWrapper, typename... Attributes>
+AttributeOctreeBase<LocationCode, MapWrapper, Attributes...>::AttributeOctreeBase() :
+    _octree(false),
+    _channels(PayloadTree<LocationCode, Attributes, MapWrapper>(Attributes())...)
+{
+}
+
+template <typename LocationCode, typename MapWrapper, typename... Attributes>
+void AttributeOctreeBase<LocationCode, MapWrapper, Attributes...>::set(LocationCode location_code, const Attributes&... values)
+{
+    _octree.set(location_code);
+
+    std::apply([&](auto&... channels)
+    {
+        (channels.set(location_code, values), ...);
+    }, _channels);
+}
+
+template <typename LocationCode, typename MapWrapper, typename... Attributes>
+void AttributeOctreeBase<LocationCode, MapWrapper, Attributes...>::clear(LocationCode location_code)
+{
+    _octree.clear(location_code);
+
+    std::apply([&](auto&... channels)
+    {
+        (channels.set(location_code, Attributes()), ...);
+    }, _channels);
+}
@@ -0,0 +1,67 @@
+#ifndef _BRICK_OCTREE_H_
+#define _BRICK_OCTREE_H_
+
+#include <cstdint>
+
+#include "octree.h"
+
+using BrickType = uint64_t; // One bit per max-depth cell of a 4x4x4 brick, in Morton order
+
+// An octree whose bottom two levels are stored as dense 64-bit bricks, one
+// per partially set node at depth (max - 2), instead of as hashed nodes.
+// Shallower levels live in an ordinary OctreeBase, where each brick is
+// anchored by an empty node at the brick's location code.
+template <typename LocationCode, typename MapWrapper>
+class BrickOctreeBase
+{
+public:
+
+    using CoarseType = OctreeBase<LocationCode, MapWrapper>;
+    using BrickMapType = typename MapWrapper::template TypeDecl<LocationCode, BrickType>::Type;
+    using LocationCodes = LocationCodesBase<LocationCode>;
+    using LocationCodeType = LocationCode;
+
+    static constexpr uint8_t get_brick_depth() { return LocationCodes::max_depth() - 2; }
+
+    BrickOctreeBase(bool full=false, size_t capacity=0);
+
+    void reserve(size_t capacity);
+
+    void set_root();
+    void clear_root();
+
+    void set(LocationCode location_code);
+    void clear(LocationCode location_code);
+
+    bool is_set(LocationCode location_code) const;
+
+    float get_volume() const;
+
+    // Calls function(location_code, depth) for every set region, in Morton order
+    template <typename Function>
+    void for_each_set(Function&& function) const;
+
+    const CoarseType& get_coarse() const { return _coarse; }
+    const BrickMapType& get_brick_map() const { return _bricks; }
+
+    static constexpr size_t get_max_depth() { return LocationCodes::max_depth(); }
+    int get_num_nodes() const { return _coarse.get_num_nodes() + _bricks.size(); }
+
+    // Bricks are counted as nodes at the brick depth
+    MemoryUsage memory_usage() const;
+
+private:
+
+    static BrickType brick_mask(LocationCode location_code);
+    void erase_bricks(LocationCode location_code);
+
+    CoarseType _coarse;
+    BrickMapType _bricks;
+};
+
+using BrickOctree32 = BrickOctreeBase<uint32_t, UnorderedMapWrapper>;
+using BrickOctree64 = BrickOctreeBase<uint64_t, UnorderedMapWrapper>;
+
+#include "brick_octree.inl.h"
+
+#endif // _BRICK_OCTREE_H_
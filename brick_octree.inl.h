@@ -0,0 +1,229 @@
+#include "brick_octree.h"
+
+constexpr BrickType FULL_BRICK = ~BrickType(0);
+
+template <typename LocationCode, typename MapType>
+BrickOctreeBase<LocationCode, MapType>::BrickOctreeBase(bool full, size_t capacity) :
+    _coarse(full, capacity)
+{
+    reserve(capacity);
+}
+
+template <typename LocationCode, typename MapType>
+void BrickOctreeBase<LocationCode, MapType>::reserve(size_t capacity)
+{
+    _coarse.reserve(capacity);
+    _bricks.reserve(capacity);
+}
+
+template <typename LocationCode, typename MapType>
+void BrickOctreeBase<LocationCode, MapType>::set_root()
+{
+    _bricks.clear();
+    MapType::release(_bricks);
+    _coarse.set_root();
+}
+
+template <typename LocationCode, typename MapType>
+void BrickOctreeBase<LocationCode, MapType>::clear_root()
+{
+    _bricks.clear();
+    MapType::release(_bricks);
+    _coarse.clear_root();
+}
+
+template <typename LocationCode, typename MapType>
+BrickType BrickOctreeBase<LocationCode, MapType>::brick_mask(LocationCode location_code)
+{
+    // A max-depth cell's final two child indices address its bit directly;
+    // a depth (max - 1) region covers eight consecutive bits.
+    if (LocationCodes::depth(location_code) == LocationCodes::max_depth())
+    {
+        return BrickType(1) << (location_code & 0x3f);
+    }
+
+    return BrickType(0xff) << (8 * LocationCodes::final_child_index(location_code));
+}
+
+template <typename LocationCode, typename MapType>
+void BrickOctreeBase<LocationCode, MapType>::erase_bricks(LocationCode location_code)
+{
+    struct Visitor : OctreeVisitor<LocationCode>
+    {
+        Visitor(BrickMapType& bricks) : bricks(bricks) {}
+
+        void enter_node(LocationCode location_code, NodeType node)
+        {
+            if (LocationCodes::depth(location_code) == get_brick_depth())
+            {
+                bricks.erase(location_code);
+            }
+        }
+
+        BrickMapType& bricks;
+    } visitor(_bricks);
+
+    _coarse.traverse(visitor, location_code);
+}
+
+template <typename LocationCode, typename MapType>
+void BrickOctreeBase<LocationCode, MapType>::set(LocationCode location_code)
+{
+    if (LocationCodes::depth(location_code) <= get_brick_depth())
+    {
+        erase_bricks(location_code);
+        _coarse.set(location_code);
+        return;
+    }
+
+    const LocationCode brick_code = location_code >> 3 * (LocationCodes::depth(location_code) - get_brick_depth());
+    const BrickType mask = brick_mask(location_code);
+    const auto it = _bricks.find(brick_code);
+
+    if (it == _bricks.end())
+    {
+        if (_coarse.create_node(brick_code) == nullptr)
+        {
+            return; // Already covered by a set ancestor
+        }
+
+        _bricks.emplace(brick_code, mask);
+        return;
+    }
+
+    it->second |= mask;
+
+    if (it->second == FULL_BRICK)
+    {
+        _bricks.erase(it);
+        _coarse.set(brick_code);
+    }
+}
+
+template <typename LocationCode, typename MapType>
+void BrickOctreeBase<LocationCode, MapType>::clear(LocationCode location_code)
+{
+    if (LocationCodes::depth(location_code) <= get_brick_depth())
+    {
+        erase_bricks(location_code);
+        _coarse.clear(location_code);
+        return;
+    }
+
+    const LocationCode brick_code = location_code >> 3 * (LocationCodes::depth(location_code) - get_brick_depth());
+    const BrickType mask = brick_mask(location_code);
+    const auto it = _bricks.find(brick_code);
+
+    if (it == _bricks.end())
+    {
+        if (!_coarse.is_set(brick_code))
+        {
+            return; // Already empty
+        }
+
+        // Split the set region down to an anchored, nearly full brick
+        _coarse.clear(brick_code);
+        _coarse.create_node(brick_code);
+        _bricks.emplace(brick_code, FULL_BRICK & ~mask);
+        return;
+    }
+
+    it->second &= ~mask;
+
+    if (it->second == 0)
+    {
+        _bricks.erase(it);
+        _coarse.clear(brick_code);
+    }
+}
+
+template <typename LocationCode, typename MapType>
+bool BrickOctreeBase<LocationCode, MapType>::is_set(LocationCode location_code) const
+{
+    if (LocationCodes::depth(location_code) <= get_brick_depth())
+    {
+        return _coarse.is_set(location_code);
+    }
+
+    const LocationCode brick_code = location_code >> 3 * (LocationCodes::depth(location_code) - get_brick_depth());
+    const auto it = _bricks.find(brick_code);
+
+    if (it == _bricks.end())
+    {
+        return _coarse.is_set(brick_code);
+    }
+
+    const BrickType mask = brick_mask(location_code);
+    return (it->second & mask) == mask;
+}
+
+template <typename LocationCode, typename MapType>
+float BrickOctreeBase<LocationCode, MapType>::get_volume() const
+{
+    uint64_t num_cells = 0;
+    for (const auto& kv : _bricks)
+    {
+        num_cells += bit_count(kv.second);
+    }
+
+    return _coarse.get_volume() + (float)((double)num_cells / (double)(uint64_t(1) << 3 * get_max_depth()));
+}
+
+template <typename LocationCode, typename MapType>
+MemoryUsage BrickOctreeBase<LocationCode, MapType>::memory_usage() const
+{
+    MemoryUsage usage = _coarse.memory_usage();
+    MapType::add_memory_usage(_bricks, usage);
+    usage.nodes_per_depth[get_brick_depth()] += _bricks.size();
+    return usage;
+}
+
+template <typename LocationCode, typename MapType>
+template <typename Function>
+void BrickOctreeBase<LocationCode, MapType>::for_each_set(Function&& function) const
+{
+    struct Visitor : OctreeVisitor<LocationCode>
+    {
+        Visitor(const BrickMapType& bricks, Function& function) : bricks(bricks), function(function) {}
+
+        void enter_node(LocationCode location_code, NodeType node)
+        {
+            if (LocationCodes::depth(location_code) != get_brick_depth())
+            {
+                return;
+            }
+
+            const BrickType brick = bricks.find(location_code)->second;
+
+            for (int i = 0; i < 8; ++i)
+            {
+                const unsigned octet = (brick >> (8 * i)) & 0xff;
+                const LocationCode child_code = LocationCodes::child_code(location_code, i);
+
+                if (octet == 0xff)
+                {
+                    function(child_code, get_brick_depth() + 1);
+                    continue;
+                }
+
+                for (int j = 0; j < 8; ++j)
+                {
+                    if (octet & (1 << j))
+                    {
+                        function(LocationCodes::child_code(child_code, j), get_brick_depth() + 2);
+                    }
+                }
+            }
+        }
+
+        void set_child(LocationCode location_code)
+        {
+            function(location_code, LocationCodes::depth(location_code));
+        }
+
+        const BrickMapType& bricks;
+        Function& function;
+    } visitor(_bricks, function);
+
+    _coarse.traverse(visitor);
+}
@@ -0,0 +1,54 @@
+#ifndef _DISTANCE_FIELD_H_
+#define _DISTANCE_FIELD_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "octree.h"
+
+// Euclidean distance to the nearest set cell, sampled at the centres of the
+// cells of a dense grid at a chosen depth. A grid cell counts as set if any
+// part of it is set. All distances and points are in units of max-depth cells.
+template <typename Octree>
+class DistanceField
+{
+public:
+
+    using LocationCode = typename Octree::LocationCodeType;
+    using LocationCodes = typename Octree::LocationCodes;
+
+    // If is_signed, cells inside the set region hold minus the distance to the
+    // nearest unset cell.
+    DistanceField(const Octree& octree, uint8_t depth, bool is_signed=false);
+
+    uint8_t get_depth() const { return _depth; }
+    uint32_t get_resolution() const { return _resolution; }
+    bool is_signed() const { return _is_signed; }
+
+    // Value at the centre of the grid cell with the given indices
+    float get(uint32_t x_index, uint32_t y_index, uint32_t z_index) const;
+
+    // Trilinear interpolation between cell centres, clamped at the borders
+    float sample(const Vertex& point) const;
+    Vertex gradient(const Vertex& point) const;
+
+private:
+
+    size_t index(uint32_t x_index, uint32_t y_index, uint32_t z_index) const
+    {
+        return ((size_t)z_index * _resolution + y_index) * _resolution + x_index;
+    }
+
+    std::vector<float> rasterize(const Octree& octree) const;
+    void transform(std::vector<float>& grid) const;
+
+    const uint8_t _depth;
+    const uint32_t _resolution;
+    const float _cell_size;
+    const bool _is_signed;
+    std::vector<float> _values;
+};
+
+#include "distance_field.inl.h"
+
+#endif // _DISTANCE_FIELD_H_
@@ -0,0 +1,254 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include "distance_field.h"
+#include "parallel.h"
+
+namespace distance_field_detail
+{
+
+constexpr float UNREACHED = std::numeric_limits<float>::infinity();
+
+// Squared 1D distance transform of a sampled function (Felzenszwalb and
+// Huttenlocher): the lower envelope of parabolas rooted at each finite sample.
+inline void transform_line(const float* f, float* d, int n, int* v, float* z)
+{
+    int k = -1;
+
+    for (int q = 0; q < n; ++q)
+    {
+        if (f[q] == UNREACHED)
+        {
+            continue;
+        }
+
+        float s = -UNREACHED;
+        while (k >= 0)
+        {
+            s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2.0f * (q - v[k]));
+            if (s > z[k])
+            {
+                break;
+            }
+            --k;
+        }
+
+        ++k;
+        v[k] = q;
+        z[k] = (k == 0) ? -UNREACHED : s;
+        z[k + 1] = UNREACHED;
+    }
+
+    if (k < 0)
+    {
+        std::fill(d, d + n, UNREACHED);
+        return;
+    }
+
+    k = 0;
+    for (int q = 0; q < n; ++q)
+    {
+        while (z[k + 1] < q)
+        {
+            ++k;
+        }
+        d[q] = (q - v[k]) * (q - v[k]) + f[v[k]];
+    }
+}
+
+} // namespace distance_field_detail
+
+template <typename Octree>
+DistanceField<Octree>::DistanceField(const Octree& octree, uint8_t depth, bool is_signed) :
+    _depth(depth),
+    _resolution(uint32_t(1) << depth),
+    _cell_size(LocationCodes::cell_size(depth)),
+    _is_signed(is_signed)
+{
+    if (depth > LocationCodes::max_depth())
+    {
+        throw std::runtime_error("DistanceField depth exceeds the maximum octree depth");
+    }
+
+    // Squared distances (in grid cells) to the nearest set cell
+    _values = rasterize(octree);
+
+    std::vector<float> inside;
+    if (_is_signed)
+    {
+        inside.resize(_values.size());
+        std::transform(_values.begin(), _values.end(), inside.begin(), [](float value)
+        {
+            return (value == 0) ? distance_field_detail::UNREACHED : 0.0f;
+        });
+        transform(inside);
+    }
+
+    transform(_values);
+
+    for (size_t i = 0; i < _values.size(); ++i)
+    {
+        _values[i] = std::sqrt(_values[i]) * _cell_size;
+        if (_is_signed && _values[i] == 0)
+        {
+            _values[i] = -std::sqrt(inside[i]) * _cell_size;
+        }
+    }
+}
+
+template <typename Octree>
+std::vector<float> DistanceField<Octree>::rasterize(const Octree& octree) const
+{
+    std::vector<float> grid((size_t)_resolution * _resolution * _resolution, distance_field_detail::UNREACHED);
+
+    // Whole set nodes fill a block of grid cells at once; anything set below
+    // the grid depth marks the single grid cell containing it.
+    const auto fill_node = [this, &grid](LocationCode location_code)
+    {
+        const int depth = LocationCodes::depth(location_code);
+        const GridPoint cell = LocationCodes::cell_index(location_code);
+
+        if (depth >= _depth)
+        {
+            const int shift = depth - _depth;
+            grid[index(cell.x >> shift, cell.y >> shift, cell.z >> shift)] = 0;
+            return;
+        }
+
+        const int shift = _depth - depth;
+        const uint32_t size = uint32_t(1) << shift;
+
+        for (uint32_t z = cell.z << shift; z < (cell.z << shift) + size; ++z)
+        {
+            for (uint32_t y = cell.y << shift; y < (cell.y << shift) + size; ++y)
+            {
+                float* row = &grid[index(cell.x << shift, y, z)];
+                std::fill(row, row + size, 0.0f);
+            }
+        }
+    };
+
+    struct Visitor : OctreeVisitor<LocationCode>
+    {
+        Visitor(decltype(fill_node)& fill, uint8_t depth) : fill(fill), depth(depth) {}
+
+        void set_child(LocationCode location_code)
+        {
+            fill(location_code);
+        }
+
+        bool prune(LocationCode location_code)
+        {
+            if (LocationCodes::depth(location_code) < depth)
+            {
+                return false;
+            }
+
+            fill(location_code);
+            return true;
+        }
+
+        decltype(fill_node)& fill;
+        const uint8_t depth;
+    } visitor(fill_node, _depth);
+
+    octree.traverse(visitor);
+
+    return grid;
+}
+
+template <typename Octree>
+void DistanceField<Octree>::transform(std::vector<float>& grid) const
+{
+    // Separable exact transform: one 1D pass per axis, each plane of lines
+    // processed independently.
+    const size_t n = _resolution;
+    const size_t strides[3] = {1, n, n * n};
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        const size_t line_stride = strides[axis];
+        const size_t inner_stride = strides[axis == 0 ? 1 : 0];
+        const size_t plane_stride = strides[axis == 2 ? 1 : 2];
+
+        parallel_for(0, n, [&](size_t plane)
+        {
+            std::vector<float> f(n), d(n), z(n + 1);
+            std::vector<int> v(n);
+
+            for (size_t inner = 0; inner < n; ++inner)
+            {
+                float* line = &grid[plane * plane_stride + inner * inner_stride];
+
+                for (size_t q = 0; q < n; ++q)
+                {
+                    f[q] = line[q * line_stride];
+                }
+
+                distance_field_detail::transform_line(f.data(), d.data(), n, v.data(), z.data());
+
+                for (size_t q = 0; q < n; ++q)
+                {
+                    line[q * line_stride] = d[q];
+                }
+            }
+        }, 1);
+    }
+}
+
+template <typename Octree>
+float DistanceField<Octree>::get(uint32_t x_index, uint32_t y_index, uint32_t z_index) const
+{
+    return _values[index(x_index, y_index, z_index)];
+}
+
+template <typename Octree>
+float DistanceField<Octree>::sample(const Vertex& point) const
+{
+    const float max_coord = _resolution - 1;
+    uint32_t lower[3];
+    float weight[3];
+    const float coords[3] = {point.x, point.y, point.z};
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        const float u = std::clamp(coords[axis] / _cell_size - 0.5f, 0.0f, max_coord);
+        lower[axis] = std::min<uint32_t>(u, (_resolution > 1) ? _resolution - 2 : 0);
+        weight[axis] = (_resolution > 1) ? u - lower[axis] : 0;
+    }
+
+    float result = 0;
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        float corner_weight = 1;
+        uint32_t indices[3];
+
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            const bool upper = corner & (1 << axis);
+            indices[axis] = lower[axis] + ((upper && _resolution > 1) ? 1 : 0);
+            corner_weight *= upper ? weight[axis] : 1 - weight[axis];
+        }
+
+        if (corner_weight != 0)
+        {
+            result += corner_weight * get(indices[0], indices[1], indices[2]);
+        }
+    }
+
+    return result;
+}
+
+template <typename Octree>
+Vertex DistanceField<Octree>::gradient(const Vertex& point) const
+{
+    const float h = _cell_size;
+
+    return Vertex(
+        (sample(Vertex(point.x + h, point.y, point.z)) - sample(Vertex(point.x - h, point.y, point.z))) / (2 * h),
+        (sample(Vertex(point.x, point.y + h, point.z)) - sample(Vertex(point.x, point.y - h, point.z))) / (2 * h),
+        (sample(Vertex(point.x, point.y, point.z + h)) - sample(Vertex(point.x, point.y, point.z - h))) / (2 * h)
+    );
+}
@@ -15,6 +15,25 @@ struct Vertex
     }
 };
 
+struct GridPoint
+{
+    // Integer coordinates in units of max-depth cells
+    uint32_t x;
+    uint32_t y;
+    uint32_t z;
+
+    inline bool operator==(const GridPoint& other) const
+    {
+        return x == other.x && y == other.y && z == other.z;
+    }
+};
+
+// Number of set bits
+inline uint8_t bit_count(uint64_t bits);
+
+// Index of the lowest set bit, which must exist
+inline uint8_t low_bit_index(uint32_t bits);
+
 template <typename T>
 struct LocationCodesBase
 {
@@ -26,6 +45,14 @@ struct LocationCodesBase
     static constexpr T parent_code(T location_code);
     static constexpr T child_code(T location_code, uint8_t child_index);
     static constexpr uint8_t final_child_index(T location_code);
+
+    // Same-depth neighbour one cell along axis (0 = x, 1 = y, 2 = z), computed
+    // with dilated integer arithmetic on the code. Returns 0 outside the grid.
+    static constexpr T neighbor_code(T location_code, uint8_t axis, bool positive);
+    static constexpr uint32_t cell_size(uint8_t depth);
+    static T encode(uint8_t depth, uint32_t x_index, uint32_t y_index, uint32_t z_index);
+    static GridPoint cell_index(T location_code);
+    static GridPoint lower_corner_point(T location_code);
     static T lower_corner_code(T location_code);
     static Vertex lower_corner(T location_code);
     static std::string to_binary(T location_code);
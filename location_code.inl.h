@@ -2,12 +2,34 @@
 #include <cstdint>
 #include <immintrin.h>
 
+// Bit utilities
+
+inline uint8_t bit_count(uint64_t bits)
+{
+#if defined(__GNUC__)
+    return __builtin_popcountll(bits);
+#elif defined(_MSC_VER)
+    return (uint8_t)__popcnt64(bits);
+#endif
+}
+
+inline uint8_t low_bit_index(uint32_t bits)
+{
+#if defined(__GNUC__)
+    return __builtin_ctz(bits);
+#elif defined(_MSC_VER)
+    unsigned long lsb;
+    _BitScanForward(&lsb, bits);
+    return lsb;
+#endif
+}
+
 // Common
 
 template <typename T>
 constexpr T LocationCodesBase<T>::high_bit(T location_code)
 {
-    return 1 << high_bit_index(location_code);
+    return T(1) << high_bit_index(location_code);
 }
 
 template <typename T>
@@ -40,6 +62,38 @@ constexpr uint8_t LocationCodesBase<T>::final_child_index(T location_code)
     return location_code & 0x7;
 }
 
+template <typename T>
+constexpr T LocationCodesBase<T>::neighbor_code(T location_code, uint8_t axis, bool positive)
+{
+    // 0b001001...001 with one bit per level
+    const T mask = (((T(1) << 3 * depth(location_code)) - 1) / 7) << axis;
+    const T bits = location_code & mask;
+
+    if (bits == (positive ? mask : 0))
+    {
+        return 0; // Stepping off the edge of the grid
+    }
+
+    // Filling the gaps with ones carries an increment across them
+    const T stepped = positive ? ((bits | ~mask) + 1) & mask : (bits - 1) & mask;
+    return (location_code & ~mask) | stepped;
+}
+
+template <typename T>
+constexpr uint32_t LocationCodesBase<T>::cell_size(uint8_t depth)
+{
+    return uint32_t(1) << (max_depth() - depth);
+}
+
+template <typename T>
+GridPoint LocationCodesBase<T>::lower_corner_point(T location_code)
+{
+    const GridPoint index = cell_index(location_code);
+    const int shift = max_depth() - depth(location_code);
+
+    return GridPoint{index.x << shift, index.y << shift, index.z << shift};
+}
+
 template <typename T>
 std::string LocationCodesBase<T>::to_binary(T location_code)
 {
@@ -89,6 +143,29 @@ uint32_t LocationCodesBase<uint32_t>::lower_corner_code(uint32_t location_code)
     ) << shift;
 }
 
+template <>
+inline uint32_t LocationCodesBase<uint32_t>::encode(uint8_t depth, uint32_t x_index, uint32_t y_index, uint32_t z_index)
+{
+    return (
+        (uint32_t(1) << 3 * depth) |
+        _pdep_u32(x_index, 0b001001001001001001001001001001) |
+        _pdep_u32(y_index, 0b010010010010010010010010010010) |
+        _pdep_u32(z_index, 0b100100100100100100100100100100)
+    );
+}
+
+template <>
+inline GridPoint LocationCodesBase<uint32_t>::cell_index(uint32_t location_code)
+{
+    const uint32_t bits = location_bits(location_code);
+
+    return GridPoint{
+        _pext_u32(bits, 0b001001001001001001001001001001),
+        _pext_u32(bits, 0b010010010010010010010010010010),
+        _pext_u32(bits, 0b100100100100100100100100100100)
+    };
+}
+
 // uint64_t
 
 template <>
@@ -149,3 +226,44 @@ uint64_t LocationCodesBase<uint64_t>::lower_corner_code(uint64_t location_code)
         )
     ) << shift;
 }
+
+template <>
+inline uint64_t LocationCodesBase<uint64_t>::encode(uint8_t depth, uint32_t x_index, uint32_t y_index, uint32_t z_index)
+{
+    return (
+        (uint64_t(1) << 3 * depth) |
+        _pdep_u64(
+            x_index, 
+            0b001001001001001001001001001001001001001001001001001001001001
+        ) |
+        _pdep_u64(
+            y_index, 
+            0b010010010010010010010010010010010010010010010010010010010010
+        ) |
+        _pdep_u64(
+            z_index, 
+            0b100100100100100100100100100100100100100100100100100100100100
+        )
+    );
+}
+
+template <>
+inline GridPoint LocationCodesBase<uint64_t>::cell_index(uint64_t location_code)
+{
+    const uint64_t bits = location_bits(location_code);
+
+    return GridPoint{
+        (uint32_t)_pext_u64(
+            bits, 
+            0b001001001001001001001001001001001001001001001001001001001001
+        ),
+        (uint32_t)_pext_u64(
+            bits, 
+            0b010010010010010010010010010010010010010010010010010010010010
+        ),
+        (uint32_t)_pext_u64(
+            bits, 
+            0b100100100100100100100100100100100100100100100100100100100100
+        )
+    };
+}
@@ -0,0 +1,32 @@
+#ifndef _MESH_VOXELIZER_H_
+#define _MESH_VOXELIZER_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "octree.h"
+
+struct Triangle
+{
+    Vertex a;
+    Vertex b;
+    Vertex c;
+};
+
+enum class VoxelizeMode { SURFACE, SOLID };
+
+// Sets every cell at depth that a triangle touches, found with exact
+// triangle-box overlap tests while descending from the smallest node that
+// contains each triangle. SOLID additionally sets the cells whose centres
+// are enclosed by the mesh, by parity along z scanlines, and expects a
+// closed mesh. Vertices are in units of max-depth cells. Triangles are
+// processed in parallel and the cells are set in Morton order.
+template <typename LocationCode, typename MapWrapper>
+void voxelize_mesh(
+    OctreeBase<LocationCode, MapWrapper>& octree, const std::vector<Triangle>& triangles, uint8_t depth,
+    VoxelizeMode mode=VoxelizeMode::SURFACE
+);
+
+#include "mesh_voxelizer.inl.h"
+
+#endif // _MESH_VOXELIZER_H_
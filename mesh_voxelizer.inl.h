@@ -0,0 +1,306 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+
+#include "mesh_voxelizer.h"
+#include "parallel.h"
+
+namespace mesh_voxelizer_detail
+{
+
+using Vec3 = std::array<float, 3>;
+
+inline Vec3 to_vec3(const Vertex& v)
+{
+    return {v.x, v.y, v.z};
+}
+
+inline Vec3 subtract(const Vec3& a, const Vec3& b)
+{
+    return {a[0] - b[0], a[1] - b[1], a[2] - b[2]};
+}
+
+inline Vec3 cross(const Vec3& a, const Vec3& b)
+{
+    return {a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]};
+}
+
+inline float dot(const Vec3& a, const Vec3& b)
+{
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+// True if the projections of the triangle and of a box with the given half
+// size, both relative to the box centre, overlap on the axis
+inline bool overlap_on_axis(const Vec3& axis, const Vec3 (&v)[3], float half_size)
+{
+    const float p0 = dot(axis, v[0]), p1 = dot(axis, v[1]), p2 = dot(axis, v[2]);
+    const float radius = half_size * (std::abs(axis[0]) + std::abs(axis[1]) + std::abs(axis[2]));
+    return std::min({p0, p1, p2}) <= radius && std::max({p0, p1, p2}) >= -radius;
+}
+
+// Separating axis test (Akenine-Moller) between a triangle and a cube: the
+// three box normals, the triangle normal and the nine edge cross products
+inline bool triangle_box_overlap(const Vec3 (&triangle)[3], const Vec3& centre, float half_size)
+{
+    const Vec3 v[3] = {subtract(triangle[0], centre), subtract(triangle[1], centre), subtract(triangle[2], centre)};
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (std::min({v[0][axis], v[1][axis], v[2][axis]}) > half_size ||
+            std::max({v[0][axis], v[1][axis], v[2][axis]}) < -half_size)
+        {
+            return false;
+        }
+    }
+
+    const Vec3 edges[3] = {subtract(v[1], v[0]), subtract(v[2], v[1]), subtract(v[0], v[2])};
+
+    if (!overlap_on_axis(cross(edges[0], edges[1]), v, half_size))
+    {
+        return false;
+    }
+
+    for (const Vec3& edge : edges)
+    {
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            Vec3 unit = {0, 0, 0};
+            unit[axis] = 1;
+
+            if (!overlap_on_axis(cross(unit, edge), v, half_size))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// Pushes the codes of the cells at depth touched by the triangle
+template <typename LocationCodes, typename LocationCode>
+void collect_surface_cells(
+    const Vec3 (&triangle)[3], uint8_t depth, std::vector<LocationCode>& stack, std::vector<LocationCode>& cells
+)
+{
+    const float grid_size = LocationCodes::cell_size(0);
+    const float cell_size = LocationCodes::cell_size(depth);
+    const uint32_t last = (uint32_t(1) << depth) - 1;
+
+    uint32_t min_index[3], max_index[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        const float low = std::min({triangle[0][axis], triangle[1][axis], triangle[2][axis]});
+        const float high = std::max({triangle[0][axis], triangle[1][axis], triangle[2][axis]});
+
+        if (high < 0 || low > grid_size)
+        {
+            return;
+        }
+
+        min_index[axis] = std::min(last, uint32_t(std::max(0.0f, low) / cell_size));
+        max_index[axis] = std::min(last, uint32_t(std::min(grid_size, high) / cell_size));
+    }
+
+    // Start from the smallest node containing the triangle's bounds
+    LocationCode low_code = LocationCodes::encode(depth, min_index[0], min_index[1], min_index[2]);
+    LocationCode high_code = LocationCodes::encode(depth, max_index[0], max_index[1], max_index[2]);
+    while (low_code != high_code)
+    {
+        low_code = LocationCodes::parent_code(low_code);
+        high_code = LocationCodes::parent_code(high_code);
+    }
+
+    stack.clear();
+    stack.push_back(low_code);
+
+    while (!stack.empty())
+    {
+        const LocationCode location_code = stack.back();
+        stack.pop_back();
+
+        const uint8_t node_depth = LocationCodes::depth(location_code);
+        const float half_size = 0.5f * LocationCodes::cell_size(node_depth);
+        const GridPoint corner = LocationCodes::lower_corner_point(location_code);
+        const Vec3 centre = {corner.x + half_size, corner.y + half_size, corner.z + half_size};
+
+        if (!triangle_box_overlap(triangle, centre, half_size))
+        {
+            continue;
+        }
+
+        if (node_depth == depth)
+        {
+            cells.push_back(location_code);
+            continue;
+        }
+
+        for (int i = 0; i < 8; ++i)
+        {
+            stack.push_back(LocationCodes::child_code(location_code, i));
+        }
+    }
+}
+
+struct Crossing
+{
+    uint64_t column; // y_index * resolution + x_index
+    float z;
+
+    bool operator<(const Crossing& other) const
+    {
+        return column < other.column || (column == other.column && z < other.z);
+    }
+};
+
+// Pushes the z of each crossing between the triangle and the z scanlines
+// through column centres. Points on shared edges count for exactly one of
+// the triangles, using a top-left rule on the counter-clockwise projection,
+// so closed meshes always give an even number of crossings per column.
+template <typename LocationCodes>
+void collect_crossings(const Vec3 (&triangle)[3], uint8_t depth, std::vector<Crossing>& crossings)
+{
+    const double cell_size = LocationCodes::cell_size(depth);
+    const int64_t last = (int64_t(1) << depth) - 1;
+
+    double x[3] = {triangle[0][0], triangle[1][0], triangle[2][0]};
+    double y[3] = {triangle[0][1], triangle[1][1], triangle[2][1]};
+    double z[3] = {triangle[0][2], triangle[1][2], triangle[2][2]};
+
+    const double area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+    if (area == 0)
+    {
+        return; // Parallel to the scanlines
+    }
+    if (area < 0)
+    {
+        std::swap(x[1], x[2]);
+        std::swap(y[1], y[2]);
+        std::swap(z[1], z[2]);
+    }
+
+    const int64_t min_i = std::max<int64_t>(0, std::ceil(std::min({x[0], x[1], x[2]}) / cell_size - 0.5));
+    const int64_t max_i = std::min<int64_t>(last, std::floor(std::max({x[0], x[1], x[2]}) / cell_size - 0.5));
+    const int64_t min_j = std::max<int64_t>(0, std::ceil(std::min({y[0], y[1], y[2]}) / cell_size - 0.5));
+    const int64_t max_j = std::min<int64_t>(last, std::floor(std::max({y[0], y[1], y[2]}) / cell_size - 0.5));
+
+    for (int64_t j = min_j; j <= max_j; ++j)
+    {
+        for (int64_t i = min_i; i <= max_i; ++i)
+        {
+            const double px = (i + 0.5) * cell_size, py = (j + 0.5) * cell_size;
+            double weights[3];
+            bool inside = true;
+
+            for (int edge = 0; edge < 3 && inside; ++edge)
+            {
+                const int a = (edge + 1) % 3, b = (edge + 2) % 3; // Edge opposite vertex `edge`
+                const double dx = x[b] - x[a], dy = y[b] - y[a];
+                weights[edge] = dx * (py - y[a]) - dy * (px - x[a]);
+
+                const bool top_left = dy < 0 || (dy == 0 && dx < 0);
+                inside = weights[edge] > 0 || (weights[edge] == 0 && top_left);
+            }
+
+            if (inside)
+            {
+                const double crossing_z = (weights[0] * z[0] + weights[1] * z[1] + weights[2] * z[2]) / std::abs(area);
+                crossings.push_back({uint64_t(j) * (last + 1) + i, float(crossing_z)});
+            }
+        }
+    }
+}
+
+} // namespace mesh_voxelizer_detail
+
+template <typename LocationCode, typename MapWrapper>
+void voxelize_mesh(
+    OctreeBase<LocationCode, MapWrapper>& octree, const std::vector<Triangle>& triangles, uint8_t depth,
+    VoxelizeMode mode
+)
+{
+    using namespace mesh_voxelizer_detail;
+    using LocationCodes = LocationCodesBase<LocationCode>;
+
+    if (depth > LocationCodes::max_depth())
+    {
+        throw std::runtime_error("voxelize_mesh depth exceeds the maximum octree depth");
+    }
+
+    const bool solid = (mode == VoxelizeMode::SOLID);
+    const size_t num_chunks = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), triangles.size() / 64));
+    std::vector<std::vector<LocationCode>> chunk_cells(num_chunks);
+    std::vector<std::vector<Crossing>> chunk_crossings(num_chunks);
+
+    parallel_for(0, num_chunks, [&](size_t chunk)
+    {
+        std::vector<LocationCode> stack;
+        const size_t begin = triangles.size() * chunk / num_chunks;
+        const size_t end = triangles.size() * (chunk + 1) / num_chunks;
+
+        for (size_t t = begin; t < end; ++t)
+        {
+            const Vec3 triangle[3] = {to_vec3(triangles[t].a), to_vec3(triangles[t].b), to_vec3(triangles[t].c)};
+            collect_surface_cells<LocationCodes>(triangle, depth, stack, chunk_cells[chunk]);
+
+            if (solid)
+            {
+                collect_crossings<LocationCodes>(triangle, depth, chunk_crossings[chunk]);
+            }
+        }
+    }, 1);
+
+    std::vector<LocationCode> cells;
+    for (const std::vector<LocationCode>& chunk : chunk_cells)
+    {
+        cells.insert(cells.end(), chunk.begin(), chunk.end());
+    }
+
+    if (solid)
+    {
+        std::vector<Crossing> crossings;
+        for (const std::vector<Crossing>& chunk : chunk_crossings)
+        {
+            crossings.insert(crossings.end(), chunk.begin(), chunk.end());
+        }
+        std::sort(crossings.begin(), crossings.end());
+
+        // Fill the cells whose centres lie between each entering and leaving crossing
+        const uint64_t resolution = uint64_t(1) << depth;
+        const float cell_size = LocationCodes::cell_size(depth);
+
+        for (size_t begin = 0; begin < crossings.size();)
+        {
+            size_t end = begin;
+            while (end < crossings.size() && crossings[end].column == crossings[begin].column)
+            {
+                ++end;
+            }
+
+            const uint32_t x_index = crossings[begin].column % resolution;
+            const uint32_t y_index = crossings[begin].column / resolution;
+
+            for (size_t i = begin; i + 1 < end; i += 2)
+            {
+                const int64_t first = std::max<int64_t>(0, std::ceil(crossings[i].z / cell_size - 0.5f));
+                const int64_t last = std::min<int64_t>(resolution, std::ceil(crossings[i + 1].z / cell_size - 0.5f));
+
+                for (int64_t z_index = first; z_index < last; ++z_index)
+                {
+                    cells.push_back(LocationCodes::encode(depth, x_index, y_index, z_index));
+                }
+            }
+
+            begin = end;
+        }
+    }
+
+    // Solid interiors arrive as whole octets, which insert_sorted() merges
+    // into their parents before touching the map
+    std::sort(cells.begin(), cells.end());
+    cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+    octree.insert_sorted(cells);
+}
@@ -0,0 +1,207 @@
+#ifndef _NODE_POOL_H_
+#define _NODE_POOL_H_
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// Hands out small fixed-size blocks from large chunks, keeping one free list
+// per size class. Chunks are only returned to the system on destruction;
+// release() rewinds the pool for reuse once every block has been returned.
+class NodePoolResource
+{
+public:
+
+    static constexpr size_t GRANULARITY = 8;
+    static constexpr size_t MAX_BLOCK_SIZE = 128;
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    NodePoolResource() :
+        _chunk_index(0),
+        _cursor(nullptr),
+        _end(nullptr),
+        _free_lists{},
+        _num_live(0),
+        _num_live_bytes(0)
+    {}
+    NodePoolResource(const NodePoolResource&) = delete;
+    NodePoolResource& operator=(const NodePoolResource&) = delete;
+
+    ~NodePoolResource()
+    {
+        for (char* chunk : _chunks)
+        {
+            ::operator delete(chunk);
+        }
+    }
+
+    static constexpr bool is_pooled(size_t size, size_t alignment)
+    {
+        return size <= MAX_BLOCK_SIZE && alignment <= GRANULARITY;
+    }
+
+    void* allocate(size_t size)
+    {
+        const size_t size_class = (size + GRANULARITY - 1) / GRANULARITY;
+        ++_num_live;
+        _num_live_bytes += size_class * GRANULARITY;
+
+        if (FreeBlock* block = _free_lists[size_class])
+        {
+            _free_lists[size_class] = block->next;
+            return block;
+        }
+
+        const size_t bytes = size_class * GRANULARITY;
+        if (_cursor == nullptr || _cursor + bytes > _end)
+        {
+            next_chunk();
+        }
+
+        void* result = _cursor;
+        _cursor += bytes;
+        return result;
+    }
+
+    void deallocate(void* pointer, size_t size)
+    {
+        const size_t size_class = (size + GRANULARITY - 1) / GRANULARITY;
+        FreeBlock* block = static_cast<FreeBlock*>(pointer);
+        block->next = _free_lists[size_class];
+        _free_lists[size_class] = block;
+        --_num_live;
+        _num_live_bytes -= size_class * GRANULARITY;
+    }
+
+    // Forgets every free list and rewinds to the first chunk. Does nothing
+    // while any block is still in use.
+    void release()
+    {
+        if (_num_live != 0 || _chunks.empty())
+        {
+            return;
+        }
+
+        _free_lists = {};
+        _chunk_index = 0;
+        _cursor = _chunks[0];
+        _end = _cursor + CHUNK_SIZE;
+    }
+
+    size_t get_num_chunks() const { return _chunks.size(); }
+    size_t get_num_live() const { return _num_live; }
+    size_t get_num_live_bytes() const { return _num_live_bytes; }
+    size_t get_num_reserved_bytes() const { return _chunks.size() * CHUNK_SIZE; }
+
+private:
+
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+
+    void next_chunk()
+    {
+        if (_cursor != nullptr)
+        {
+            ++_chunk_index;
+        }
+
+        if (_chunk_index == _chunks.size())
+        {
+            _chunks.push_back(static_cast<char*>(::operator new(CHUNK_SIZE)));
+        }
+
+        _cursor = _chunks[_chunk_index];
+        _end = _cursor + CHUNK_SIZE;
+    }
+
+    std::vector<char*> _chunks;
+    size_t _chunk_index;
+    char* _cursor;
+    char* _end;
+    std::array<FreeBlock*, MAX_BLOCK_SIZE / GRANULARITY + 1> _free_lists;
+    size_t _num_live;
+    size_t _num_live_bytes;
+};
+
+// Allocator serving single-object requests (hash map nodes) from a shared
+// NodePoolResource, and everything else (bucket arrays) from operator new.
+// Each default-constructed allocator, and each container copy, gets its own
+// pool; rebound copies share it.
+template <typename T>
+class NodePoolAllocator
+{
+public:
+
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::false_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    NodePoolAllocator() : _resource(std::make_shared<NodePoolResource>()) {}
+    NodePoolAllocator(const NodePoolAllocator&) = default;
+    NodePoolAllocator& operator=(const NodePoolAllocator&) = default;
+
+    template <typename U>
+    NodePoolAllocator(const NodePoolAllocator<U>& other) : _resource(other.get_resource_ptr()) {}
+
+    T* allocate(size_t n)
+    {
+        if (n == 1 && NodePoolResource::is_pooled(sizeof(T), alignof(T)))
+        {
+            return static_cast<T*>(_resource->allocate(sizeof(T)));
+        }
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* pointer, size_t n)
+    {
+        if (n == 1 && NodePoolResource::is_pooled(sizeof(T), alignof(T)))
+        {
+            _resource->deallocate(pointer, sizeof(T));
+            return;
+        }
+        ::operator delete(pointer);
+    }
+
+    NodePoolAllocator select_on_container_copy_construction() const { return NodePoolAllocator(); }
+
+    NodePoolResource& get_resource() const { return *_resource; }
+    const std::shared_ptr<NodePoolResource>& get_resource_ptr() const { return _resource; }
+
+    template <typename U>
+    bool operator==(const NodePoolAllocator<U>& other) const { return _resource == other.get_resource_ptr(); }
+    template <typename U>
+    bool operator!=(const NodePoolAllocator<U>& other) const { return !(*this == other); }
+
+private:
+
+    std::shared_ptr<NodePoolResource> _resource;
+};
+
+// Called by map wrappers once a map has been emptied
+template <typename Allocator>
+void release_allocator(const Allocator&) {}
+
+template <typename T>
+void release_allocator(const NodePoolAllocator<T>& allocator)
+{
+    allocator.get_resource().release();
+}
+
+// Bytes an allocator holds beyond what its live allocations use
+template <typename Allocator>
+size_t allocator_unused_bytes(const Allocator&) { return 0; }
+
+template <typename T>
+size_t allocator_unused_bytes(const NodePoolAllocator<T>& allocator)
+{
+    const NodePoolResource& resource = allocator.get_resource();
+    return resource.get_num_reserved_bytes() - resource.get_num_live_bytes();
+}
+
+#endif // _NODE_POOL_H_
@@ -0,0 +1,61 @@
+#ifndef _OCCUPANCY_OCTREE_H_
+#define _OCCUPANCY_OCTREE_H_
+
+#include <cstdint>
+#include <optional>
+
+#include "octree.h"
+#include "payload_tree.h"
+
+// Log-odds are stored as int8_t in units of scale, 0 meaning unknown
+struct OccupancyParameters
+{
+    int8_t hit = 14;       // About +0.85, p = 0.7
+    int8_t miss = -6;      // About -0.4, p = 0.4
+    int8_t min = -32;      // Clamping bounds; saturated regions prune
+    int8_t max = 56;
+    int8_t threshold = 0;  // Occupied above this
+    float scale = 1.0f / 16;
+};
+
+// Probabilistic occupancy: clamped log-odds in a PayloadTree, mirrored as
+// binary occupancy in an OctreeBase so that every existing query works on
+// the occupied cells unchanged.
+template <typename LocationCode, typename MapWrapper=UnorderedMapWrapper>
+class OccupancyOctreeBase
+{
+public:
+
+    using OctreeType = OctreeBase<LocationCode, MapWrapper>;
+    using LogOddsTreeType = PayloadTree<LocationCode, int8_t, MapWrapper>;
+    using LocationCodes = LocationCodesBase<LocationCode>;
+    using LocationCodeType = LocationCode;
+
+    explicit OccupancyOctreeBase(const OccupancyParameters& parameters=OccupancyParameters());
+
+    // Adds a hit or a miss to every cell in the region
+    void update(LocationCode location_code, bool hit);
+
+    bool is_occupied(LocationCode location_code) const { return _occupancy.is_set(location_code); }
+
+    // Nullopt if the region holds differing values
+    std::optional<int8_t> get_log_odds(LocationCode location_code) const { return _log_odds.get(location_code); }
+    std::optional<float> get_probability(LocationCode location_code) const;
+
+    const OccupancyParameters& get_parameters() const { return _parameters; }
+    const OctreeType& get_occupancy() const { return _occupancy; }
+    const LogOddsTreeType& get_log_odds_tree() const { return _log_odds; }
+
+private:
+
+    OccupancyParameters _parameters;
+    OctreeType _occupancy;
+    LogOddsTreeType _log_odds;
+};
+
+using OccupancyOctree32 = OccupancyOctreeBase<uint32_t>;
+using OccupancyOctree64 = OccupancyOctreeBase<uint64_t>;
+
+#include "occupancy_octree.inl.h"
+
+#endif // _OCCUPANCY_OCTREE_H_
@@ -0,0 +1,47 @@
+#include <algorithm>
+#include <cmath>
+
+#include "occupancy_octree.h"
+
+template <typename LocationCode, typename MapWrapper>
+OccupancyOctreeBase<LocationCode, MapWrapper>::OccupancyOctreeBase(const OccupancyParameters& parameters) :
+    _parameters(parameters),
+    _occupancy(false),
+    _log_odds(0)
+{
+}
+
+template <typename LocationCode, typename MapWrapper>
+void OccupancyOctreeBase<LocationCode, MapWrapper>::update(LocationCode location_code, bool hit)
+{
+    const int delta = hit ? _parameters.hit : _parameters.miss;
+
+    _log_odds.update(location_code, [&](int8_t& log_odds)
+    {
+        log_odds = std::clamp<int>(log_odds + delta, _parameters.min, _parameters.max);
+    });
+
+    _log_odds.for_each_leaf([&](LocationCode leaf_location_code, int8_t log_odds)
+    {
+        if (log_odds > _parameters.threshold)
+        {
+            _occupancy.set(leaf_location_code);
+        }
+        else
+        {
+            _occupancy.clear(leaf_location_code);
+        }
+    }, location_code);
+}
+
+template <typename LocationCode, typename MapWrapper>
+std::optional<float> OccupancyOctreeBase<LocationCode, MapWrapper>::get_probability(LocationCode location_code) const
+{
+    const std::optional<int8_t> log_odds = _log_odds.get(location_code);
+    if (!log_odds)
+    {
+        return std::nullopt;
+    }
+
+    return 1.0f / (1.0f + std::exp(-*log_odds * _parameters.scale));
+}
@@ -1,19 +1,84 @@
 #ifndef _OCTREE_H_
 #define _OCTREE_H_
 
+#include <array>
 #include <cstdint>
 #include <fstream>
 #include <iostream>
+#include <iterator>
 #include <optional>
 #include <unordered_map>
+#include <vector>
 
 #include "location_code.h"
+#include "node_pool.h"
+#include "octree_stats.h"
 
 enum class ExportFormat { OBJ_FORMAT };
 
+// Structuring elements for dilate() and erode(): all cells within the radius
+// in Chebyshev (cube) or Euclidean (sphere) distance
+enum class MorphologyElement { CUBE, SPHERE };
+
+// Regions are connected when they share a face (6-connectivity), also an
+// edge (18) or also a corner (26)
+enum class Connectivity { FACES, EDGES, CORNERS };
+
+template <typename LocationCode>
+struct ComponentLabeling
+{
+    std::vector<LocationCode> regions; // Set regions in Morton order
+    std::vector<uint32_t> labels;      // Component of each region, numbered in order of first region
+    uint32_t num_components = 0;
+};
+
+// When a cell of a coarsened tree is set: if any part, more than half or all
+// of it is set in the source tree
+enum class CoarsenPolicy { ANY, MAJORITY, ALL };
+
 using NodeType = uint16_t; // 8 bits child values then 8 bits child exists
 using OptionalNodeType = std::optional<NodeType>;
 
+template <typename LocationCode>
+struct SetRegion
+{
+    LocationCode location_code;
+    uint8_t depth;
+};
+
+// World-space box mapped onto the root region
+struct BoundingBox
+{
+    Vertex min;
+    Vertex max;
+};
+
+struct MemoryUsage
+{
+    size_t num_nodes = 0;
+    size_t num_buckets = 0;
+    size_t bucket_bytes = 0; // Bucket arrays
+    size_t node_bytes = 0;   // Stored entries, including per-entry map overhead
+    size_t wasted_bytes = 0; // Empty buckets plus allocator capacity not in use
+    std::vector<size_t> nodes_per_depth;
+
+    size_t get_total_bytes() const { return bucket_bytes + node_bytes + wasted_bytes; }
+    float get_load_factor() const { return num_buckets ? (float)num_nodes / num_buckets : 0; }
+};
+
+// Base for traverse() visitors; hide whichever hooks are needed. Hooks are
+// resolved at compile time, so unused ones cost nothing.
+template <typename LocationCode>
+struct OctreeVisitor
+{
+    void enter_node(LocationCode location_code, NodeType node) {}
+    void set_child(LocationCode location_code) {}
+    void exit_node(LocationCode location_code, NodeType node) {}
+
+    // Return true to skip an existing child node and its subtree
+    bool prune(LocationCode location_code) { return false; }
+};
+
 template <typename LocationCode, typename MapWrapper>
 class OctreeBase
 {
@@ -21,6 +86,68 @@ public:
 
     using NodeMapType = typename MapWrapper::template TypeDecl<LocationCode, NodeType>::Type;
     using LocationCodes = LocationCodesBase<LocationCode>;
+    using LocationCodeType = LocationCode;
+
+    struct NearestSet
+    {
+        LocationCode location_code; // Maximal set region
+        float distance;
+    };
+
+    struct TraversalFrame
+    {
+        LocationCode location_code;
+        NodeType node;
+        uint8_t next_child;
+    };
+
+    using TraversalStack = std::array<TraversalFrame, LocationCodes::max_depth()>;
+
+    // Forward iterator over the fully set child regions, in Morton order.
+    // Holds a fixed-size stack, so stepping never allocates.
+    class SetRegionIterator
+    {
+    public:
+
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = SetRegion<LocationCode>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type*;
+        using reference = const value_type&;
+
+        SetRegionIterator() : _tree(nullptr), _size(0), _current{0, 0} {}
+        explicit SetRegionIterator(const OctreeBase* tree);
+
+        reference operator*() const { return _current; }
+        pointer operator->() const { return &_current; }
+
+        SetRegionIterator& operator++() { advance(); return *this; }
+        SetRegionIterator operator++(int) { SetRegionIterator old = *this; advance(); return old; }
+
+        bool operator==(const SetRegionIterator& other) const
+        {
+            return _size == other._size && (_size == 0 || _current.location_code == other._current.location_code);
+        }
+        bool operator!=(const SetRegionIterator& other) const { return !(*this == other); }
+
+    private:
+
+        void push(LocationCode location_code);
+        void advance();
+
+        const OctreeBase* _tree;
+        TraversalStack _stack;
+        size_t _size;
+        value_type _current;
+    };
+
+    struct SetRegionRange
+    {
+        SetRegionIterator begin() const { return SetRegionIterator(tree); }
+        SetRegionIterator end() const { return SetRegionIterator(); }
+
+        const OctreeBase* tree;
+    };
 
     OctreeBase(bool full=false, size_t capacity=0);
 
@@ -32,8 +159,96 @@ public:
     void set(LocationCode location_code);
     void clear(LocationCode location_code);
 
+    // Sets every cell at depth whose centre has sdf(centre) < 0, with points
+    // in units of max-depth cells. sdf must be Lipschitz with the given
+    // constant (1 for a true distance), which lets whole nodes far from the
+    // surface be set or skipped with a single evaluation.
+    template <typename Sdf>
+    void set_sdf(Sdf&& sdf, uint8_t depth, float lipschitz=1.0f);
+
+    // Sets the cells at depth containing the points, given as interleaved
+    // xyz world coordinates. Points outside the half-open bounds are ignored.
+    void insert_points(const float* xyz, size_t num_points, const BoundingBox& bounds, uint8_t depth);
+
+    // Sets the half-open box [min, max), in units of max-depth cells, as the
+    // fewest aligned regions
+    void set_box(const GridPoint& min, const GridPoint& max);
+
+    // Sets each of the codes, which must be unique, sorted and all of the
+    // same depth. Complete octets are merged before touching the map.
+    void insert_sorted(std::vector<LocationCode>& location_codes);
+
+    // Occupancy map update: clears the cells at depth crossed by the rays from
+    // origin to each point and sets the cells holding the points, which win
+    // over clears from other rays. Points are in units of max-depth cells.
+    void integrate_scan(const Vertex& origin, const std::vector<Vertex>& points, uint8_t depth);
+
+    // True if the whole region is set, either directly or by an ancestor
+    bool is_set(LocationCode location_code) const;
+
     float get_volume() const;
 
+    // Fraction of the region that is set. With the fill cache enabled, node
+    // volumes are memoized on first use and dropped along the ancestor path by
+    // set(), clear() and create_node(), so repeated queries are O(1). Queries
+    // then write to the cache, so they must not run concurrently.
+    float get_fill_fraction(LocationCode location_code) const;
+    void enable_fill_cache(bool enabled);
+    bool is_fill_cache_enabled() const { return _fill_cache_enabled; }
+    size_t get_fill_cache_size() const { return _fill_cache.size(); }
+
+    // Area of the boundary between set and unset space, with space outside
+    // the grid unset, in units where a face of the root has area 1. With
+    // tracking enabled, set() and clear() update it from the faces around the
+    // changed region, making this O(1).
+    float get_surface_area() const;
+    void enable_surface_tracking(bool enabled);
+    bool is_surface_tracking_enabled() const { return _surface_tracking_enabled; }
+
+    // Copy truncated at depth, with cells at that depth set by the policy
+    OctreeBase coarsen(uint8_t depth, CoarsenPolicy policy=CoarsenPolicy::ANY) const;
+
+    // Connected components of the set regions, found with union-find over
+    // region adjacency rather than over individual cells
+    ComponentLabeling<LocationCode> label_components(Connectivity connectivity=Connectivity::FACES) const;
+
+    // Unset space reachable from the seed (in units of max-depth cells) by
+    // moving between touching unset regions. Work grows with the number of
+    // regions reached, never with the number of cells they contain. Throws if
+    // the seed is outside the grid.
+    OctreeBase flood_fill(const GridPoint& seed, Connectivity connectivity=Connectivity::FACES) const;
+
+    // Tree with every region flipped between set and unset
+    OctreeBase complement() const;
+
+    // Morphology on the cells at depth, with radius in those cells. Cells
+    // only partly set count as set for dilation and unset for erosion, and
+    // space outside the grid counts as unset. Each set region only adds its
+    // boundary slabs, with Morton-ordered ranges of regions dilated in parallel.
+    OctreeBase dilate(uint32_t radius, uint8_t depth, MorphologyElement element=MorphologyElement::CUBE) const;
+    OctreeBase erode(uint32_t radius, uint8_t depth, MorphologyElement element=MorphologyElement::CUBE) const;
+
+    // Boxes are half-open, [min, max), in units of max-depth cells
+    std::vector<LocationCode> query_box(const GridPoint& min, const GridPoint& max) const;
+    float volume_in_box(const GridPoint& min, const GridPoint& max) const;
+
+    // Point and radius are in units of max-depth cells
+    std::optional<NearestSet> nearest_set(const Vertex& point, float max_radius) const;
+
+    // Distance along the ray to the first set region hit, if within max_distance
+    std::optional<float> raycast(const Vertex& origin, const Vertex& direction, float max_distance) const;
+
+    // Depth-first, non-recursive walk of the subtree below location_code,
+    // visiting children in Morton order
+    template <typename Visitor>
+    void traverse(Visitor& visitor, LocationCode location_code=1) const;
+
+    SetRegionRange set_regions() const { return SetRegionRange{this}; }
+
+    // Calls function(location_code, depth) for every set region, in Morton order
+    template <typename Function>
+    void for_each_set(Function&& function) const;
+
     NodeType* get_node_ptr(LocationCode location_code);
     OptionalNodeType get_node(LocationCode location_code) const;
 
@@ -42,6 +257,18 @@ public:
     static constexpr size_t get_max_depth()  { return LocationCodes::max_depth(); }
     int get_num_nodes() const { return 1 + _nodes.size(); }
 
+    MemoryUsage memory_usage() const;
+
+    // All zero unless built with OCTREE_ENABLE_STATS. With stats enabled even
+    // const queries bump the counters, so they must not run concurrently.
+#ifdef OCTREE_ENABLE_STATS
+    const OctreeStats& get_stats() const { return _stats; }
+    void reset_stats() { _stats.reset(); }
+#else
+    const OctreeStats& get_stats() const { static const OctreeStats none; return none; }
+    void reset_stats() {}
+#endif
+
     //friend std::ostream& operator<<(std::ostream&, const OctreeBase&);
 
     std::string to_string() const;
@@ -50,13 +277,51 @@ public:
 
 private:
 
+    template <typename, typename> friend class BrickOctreeBase;
+    template <typename> friend class PointerOctreeBase;
+
     void export_obj(std::ostream& os) const;
 
+    // Returns the node at location_code, creating it (empty) and its ancestors
+    // if needed, or nullptr if the region is already covered by a set ancestor.
+    // Only the engines that anchor or fill nodes directly may call it, and they
+    // keep the tree's invariants themselves; surface tracking is not updated.
+    NodeType* create_node(LocationCode location_code);
+
     NodeType get_node_unsafe(LocationCode location_code) const;
     void erase_node(LocationCode location_code);
-    LocationCode get_node_volume(LocationCode location_code, LocationCode child_volume) const;
+    template <typename Sdf>
+    bool set_sdf_node(Sdf& sdf, LocationCode location_code, uint8_t depth, float lipschitz);
+    LocationCode get_node_volume(LocationCode location_code) const;
+    LocationCode get_cached_node_volume(LocationCode location_code) const;
+    void invalidate_fill_cache(LocationCode location_code);
+    void track_surface_change(LocationCode location_code, bool value);
+    uint64_t get_content_surface(LocationCode location_code) const;
+    uint64_t get_exposed_surface(LocationCode location_code) const;
+    static uint64_t get_face_area(uint8_t depth) { return uint64_t(1) << 2 * (LocationCodes::max_depth() - depth); }
+    static void trace_ray(
+        const Vertex& origin, const Vertex& end, uint8_t depth, std::vector<LocationCode>& free_cells,
+        std::vector<LocationCode>& hit_cells
+    );
+    static std::vector<std::array<int, 3>> neighbor_offsets(Connectivity connectivity);
+    template <typename Function>
+    void for_each_set_touching(LocationCode location_code, const std::array<int, 3>& offset, Function& function) const;
+    static void set_cell_box(OctreeBase& octree, const int64_t (&min)[3], const int64_t (&max)[3], uint8_t depth);
+    static void add_dilation(OctreeBase& octree, LocationCode location_code, uint32_t radius, uint8_t depth, MorphologyElement element);
+    static uint64_t box_overlap(LocationCode location_code, const GridPoint& min, const GridPoint& max);
+    static float box_distance_sq(LocationCode location_code, const Vertex& point);
 
     NodeMapType _nodes;
+
+    bool _fill_cache_enabled = false;
+    mutable std::unordered_map<LocationCode, LocationCode> _fill_cache; // Node volumes
+
+    bool _surface_tracking_enabled = false;
+    uint64_t _surface_area = 0; // In max-depth cell faces
+
+#ifdef OCTREE_ENABLE_STATS
+    mutable OctreeStats _stats;
+#endif
 };
 
 template <typename LocationCode, typename MapType>
@@ -67,17 +332,52 @@ std::ostream& operator<<(std::ostream&, const typename OctreeBase<LocationCode,
 
 ////////////
 
-struct UnorderedMapWrapper
+template <template <typename> class Allocator = std::allocator>
+struct BasicUnorderedMapWrapper
 {
     template <typename Key, typename Value>
     struct TypeDecl
     {
-        using Type = std::unordered_map<Key, Value>;
+        using Type = std::unordered_map<
+            Key, Value, std::hash<Key>, std::equal_to<Key>, Allocator<std::pair<const Key, Value>>
+        >;
     };
+
+    // Called after clearing a map, so pooled allocators can recycle everything
+    template <typename Map>
+    static void release(Map& map)
+    {
+        release_allocator(map.get_allocator());
+    }
+
+    template <typename Map>
+    static void add_memory_usage(const Map& map, MemoryUsage& usage)
+    {
+        // Estimated for node-based implementations: each entry is a
+        // separately allocated node holding a next pointer and the value.
+        const size_t node_size = sizeof(void*) + sizeof(typename Map::value_type);
+
+        size_t empty_buckets = 0;
+        for (size_t i = 0; i < map.bucket_count(); ++i)
+        {
+            empty_buckets += (map.bucket_size(i) == 0);
+        }
+
+        usage.num_nodes += map.size();
+        usage.num_buckets += map.bucket_count();
+        usage.bucket_bytes += (map.bucket_count() - empty_buckets) * sizeof(void*);
+        usage.node_bytes += map.size() * node_size;
+        usage.wasted_bytes += empty_buckets * sizeof(void*) + allocator_unused_bytes(map.get_allocator());
+    }
 };
 
+using UnorderedMapWrapper = BasicUnorderedMapWrapper<>;
+using PooledUnorderedMapWrapper = BasicUnorderedMapWrapper<NodePoolAllocator>;
+
 using Octree32 = OctreeBase<uint32_t, UnorderedMapWrapper>;
 using Octree64 = OctreeBase<uint64_t, UnorderedMapWrapper>;
+using PooledOctree32 = OctreeBase<uint32_t, PooledUnorderedMapWrapper>;
+using PooledOctree64 = OctreeBase<uint64_t, PooledUnorderedMapWrapper>;
 
 #include "octree.inl.h"
 
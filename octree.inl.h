@@ -1,12 +1,18 @@
 #include <algorithm>
+#include <cmath>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <limits>
+#include <numeric>
+#include <queue>
+#include <sstream>
 #include <string>
+#include <unordered_set>
 #include <vector>
 
 #include "octree.h"
+#include "parallel.h"
 
 constexpr NodeType ALL_CHILDREN_SET = 0xff00;
 
@@ -37,6 +43,45 @@ inline void set_child_value(NodeType& node, int i)
     node &= ~(1 << i); // Clear exists
 }
 
+inline void clear_child(NodeType& node, int i)
+{
+    node &= ~((1 << (i + 8)) | (1 << i)); // Clear value and exists
+}
+
+// LSD radix sort on the low num_bits bits of the keys, using scratch as the
+// second buffer
+template <typename T>
+void radix_sort(std::vector<T>& keys, std::vector<T>& scratch, int num_bits)
+{
+    constexpr int DIGIT_BITS = 8;
+    scratch.resize(keys.size());
+
+    for (int shift = 0; shift < num_bits; shift += DIGIT_BITS)
+    {
+        size_t offsets[1 << DIGIT_BITS] = {};
+        for (T key : keys)
+        {
+            ++offsets[(key >> shift) & 0xff];
+        }
+
+        size_t total = 0;
+        for (size_t& offset : offsets)
+        {
+            const size_t count = offset;
+            offset = total;
+            total += count;
+        }
+
+        for (T key : keys)
+        {
+            scratch[offsets[(key >> shift) & 0xff]++] = key;
+        }
+        keys.swap(scratch);
+    }
+}
+
+#include "raycast.h"
+
 template <typename LocationCode, typename MapType>
 OctreeBase<LocationCode, MapType>::OctreeBase(bool full, size_t capacity)
 {
@@ -53,20 +98,37 @@ void OctreeBase<LocationCode, MapType>::reserve(size_t capacity)
 template <typename LocationCode, typename MapType>
 void OctreeBase<LocationCode, MapType>::set_root()
 {
+    _fill_cache.clear();
+    _surface_area = _surface_tracking_enabled ? 6 * get_face_area(0) : 0;
     _nodes.clear();
+    MapType::release(_nodes);
     _nodes.emplace(1, ALL_CHILDREN_SET);
 }
 
 template <typename LocationCode, typename MapType>
 void OctreeBase<LocationCode, MapType>::clear_root()
 {
+    _fill_cache.clear();
+    _surface_area = 0;
     _nodes.clear();
+    MapType::release(_nodes);
     _nodes.emplace(1, 0);
 }
 
 template <typename LocationCode, typename MapType>
 void OctreeBase<LocationCode, MapType>::set(LocationCode location_code)
 {
+    if (_fill_cache_enabled)
+    {
+        invalidate_fill_cache(location_code);
+    }
+
+    if (_surface_tracking_enabled)
+    {
+        track_surface_change(location_code, true);
+        return;
+    }
+
     if (location_code == 1) // Root - there is no parent
     {
         set_root();
@@ -85,11 +147,13 @@ void OctreeBase<LocationCode, MapType>::set(LocationCode location_code)
         const LocationCode ancestor_location_code = location_code >> 3 * (parent_depth + 1 - depth);
         const int child_index = LocationCodes::final_child_index(location_code >> 3 * (parent_depth - depth));
         const auto result = _nodes.emplace(ancestor_location_code, 1 << child_index);
+        OCTREE_STAT(_stats.record_emplace(depth, result.second));
 
         if (!result.second)
         {
             if (get_child_set(result.first->second, child_index))
             {
+                OCTREE_STAT(++_stats.ancestor_set_returns);
                 return; // This child is already set fully; no need to traverse
             }
 
@@ -99,6 +163,7 @@ void OctreeBase<LocationCode, MapType>::set(LocationCode location_code)
 
     // Now we are at the parent depth
     const auto result = _nodes.emplace(parent_location_code, 1 << (LocationCodes::final_child_index(location_code) + 8));
+    OCTREE_STAT(_stats.record_emplace(parent_depth, result.second));
 
     if (result.second) // The parent node didn't exist
     {
@@ -123,6 +188,8 @@ void OctreeBase<LocationCode, MapType>::set(LocationCode location_code)
     {
         if (*node == ALL_CHILDREN_SET)
         {
+            OCTREE_STAT(++_stats.collapse_steps);
+
             // Erase and set the parent as set
             erase_node(ancestor_location_code);
             const int child_index = LocationCodes::final_child_index(ancestor_location_code);
@@ -140,18 +207,438 @@ void OctreeBase<LocationCode, MapType>::set(LocationCode location_code)
 template <typename LocationCode, typename MapType>
 void OctreeBase<LocationCode, MapType>::clear(LocationCode location_code)
 {
+    if (_fill_cache_enabled)
+    {
+        invalidate_fill_cache(location_code);
+    }
+
+    if (_surface_tracking_enabled)
+    {
+        track_surface_change(location_code, false);
+        return;
+    }
+
+    if (location_code == 1) // Root - there is no parent
+    {
+        clear_root();
+        return;
+    }
+
+    const LocationCode parent_location_code = LocationCodes::parent_code(location_code);
+    const int parent_depth = LocationCodes::depth(parent_location_code);
+
+    // Iterate down from the root to the parent, splitting any set ancestor
+    // into a node with all its children set.
+    NodeType* node = get_node_ptr(1);
+
+    for (int depth = 0; depth < parent_depth; ++depth)
+    {
+        const LocationCode child_location_code = location_code >> 3 * (parent_depth - depth);
+        const int child_index = LocationCodes::final_child_index(child_location_code);
+
+        if (get_child_exists(*node, child_index))
+        {
+            node = get_node_ptr(child_location_code);
+        }
+        else if (get_child_set_if_not_exists(*node, child_index))
+        {
+            set_child_exists(*node, child_index);
+            node = &_nodes.emplace(child_location_code, ALL_CHILDREN_SET).first->second;
+        }
+        else
+        {
+            return; // This child is already empty; no need to traverse
+        }
+    }
+
+    // Now we are at the parent depth
+    const int child_index = LocationCodes::final_child_index(location_code);
+
+    if (get_child_exists(*node, child_index))
+    {
+        erase_node(location_code);
+    }
+    clear_child(*node, child_index);
+
+    // Ancestors left with no children at all are erased and cleared in their
+    // parents, stopping at the root which always exists.
+    LocationCode ancestor_location_code = parent_location_code;
+
+    while (*node == 0 && ancestor_location_code != 1)
+    {
+        _nodes.erase(ancestor_location_code);
+        const int ancestor_index = LocationCodes::final_child_index(ancestor_location_code);
+        ancestor_location_code = LocationCodes::parent_code(ancestor_location_code);
+        node = get_node_ptr(ancestor_location_code);
+        clear_child(*node, ancestor_index);
+    }
+}
+
+template <typename LocationCode, typename MapType>
+template <typename Sdf>
+void OctreeBase<LocationCode, MapType>::set_sdf(Sdf&& sdf, uint8_t depth, float lipschitz)
+{
+    if (set_sdf_node(sdf, 1, std::min<uint8_t>(depth, LocationCodes::max_depth()), lipschitz))
+    {
+        set_root();
+    }
+}
+
+// Returns true if the whole region is inside, leaving it to the caller to set
+// so that uniform octets are set once at the highest level. Partially inside
+// regions set their own inside children.
+template <typename LocationCode, typename MapType>
+template <typename Sdf>
+bool OctreeBase<LocationCode, MapType>::set_sdf_node(Sdf& sdf, LocationCode location_code, uint8_t depth, float lipschitz)
+{
+    const uint8_t node_depth = LocationCodes::depth(location_code);
+    const float half_size = 0.5f * LocationCodes::cell_size(node_depth);
+    const Vertex corner = LocationCodes::lower_corner(location_code);
+    const float distance = sdf(Vertex(corner.x + half_size, corner.y + half_size, corner.z + half_size));
+
+    if (node_depth == depth)
+    {
+        return distance < 0;
+    }
+
+    // No cell centre in the region is further than the half diagonal away
+    const float bound = lipschitz * half_size * std::sqrt(3.0f);
+    if (distance >= bound)
+    {
+        return false;
+    }
+    if (distance <= -bound)
+    {
+        return true;
+    }
+
+    uint8_t inside = 0;
+    for (int i = 0; i < 8; ++i)
+    {
+        inside |= set_sdf_node(sdf, LocationCodes::child_code(location_code, i), depth, lipschitz) << i;
+    }
+
+    if (inside == 0xff)
+    {
+        return true;
+    }
+
+    for (int i = 0; i < 8; ++i)
+    {
+        if (inside & (1 << i))
+        {
+            set(LocationCodes::child_code(location_code, i));
+        }
+    }
+
+    return false;
+}
+
+template <typename LocationCode, typename MapType>
+void OctreeBase<LocationCode, MapType>::insert_points(const float* xyz, size_t num_points, const BoundingBox& bounds, uint8_t depth)
+{
+    depth = std::min<uint8_t>(depth, LocationCodes::max_depth());
+    const float resolution = float(uint32_t(1) << depth);
+    const float scale[3] = {
+        resolution / (bounds.max.x - bounds.min.x),
+        resolution / (bounds.max.y - bounds.min.y),
+        resolution / (bounds.max.z - bounds.min.z)
+    };
+    const float offset[3] = {bounds.min.x, bounds.min.y, bounds.min.z};
+
+    // Quantize in a branch-free loop the compiler can vectorize. Points
+    // outside the bounds (or NaN) get code 0, which is never a valid code.
+    std::vector<uint32_t> indices(3 * num_points);
+    std::vector<uint8_t> inside(num_points);
+
+    for (size_t i = 0; i < num_points; ++i)
+    {
+        const float x = (xyz[3 * i] - offset[0]) * scale[0];
+        const float y = (xyz[3 * i + 1] - offset[1]) * scale[1];
+        const float z = (xyz[3 * i + 2] - offset[2]) * scale[2];
+        inside[i] = (x >= 0) & (x < resolution) & (y >= 0) & (y < resolution) & (z >= 0) & (z < resolution);
+        indices[3 * i] = inside[i] ? uint32_t(x) : 0;
+        indices[3 * i + 1] = inside[i] ? uint32_t(y) : 0;
+        indices[3 * i + 2] = inside[i] ? uint32_t(z) : 0;
+    }
+
+    std::vector<LocationCode> location_codes(num_points);
+    for (size_t i = 0; i < num_points; ++i)
+    {
+        location_codes[i] = inside[i] ? LocationCodes::encode(depth, indices[3 * i], indices[3 * i + 1], indices[3 * i + 2]) : 0;
+    }
+
+    std::vector<LocationCode> scratch;
+    radix_sort(location_codes, scratch, 3 * depth + 1);
+    location_codes.erase(std::unique(location_codes.begin(), location_codes.end()), location_codes.end());
+    if (!location_codes.empty() && location_codes.front() == 0)
+    {
+        location_codes.erase(location_codes.begin());
+    }
+
+    insert_sorted(location_codes);
+}
+
+template <typename LocationCode, typename MapType>
+void OctreeBase<LocationCode, MapType>::set_box(const GridPoint& min, const GridPoint& max)
+{
+    std::array<LocationCode, 7 * LocationCodes::max_depth() + 1> stack;
+    size_t size = 0;
+    stack[size++] = 1;
+
+    while (size > 0)
+    {
+        const LocationCode location_code = stack[--size];
+        const uint64_t cell_size = LocationCodes::cell_size(LocationCodes::depth(location_code));
+        const uint64_t overlap = box_overlap(location_code, min, max);
+
+        if (overlap == cell_size * cell_size * cell_size)
+        {
+            set(location_code);
+        }
+        else if (overlap != 0)
+        {
+            for (int i = 7; i >= 0; --i)
+            {
+                stack[size++] = LocationCodes::child_code(location_code, i);
+            }
+        }
+    }
+}
+
+template <typename LocationCode, typename MapType>
+void OctreeBase<LocationCode, MapType>::insert_sorted(std::vector<LocationCode>& location_codes)
+{
+    // Each pass replaces runs of eight siblings by their parent, keeping the
+    // parents (still sorted) for the next pass and setting the rest.
+    std::vector<LocationCode> parents;
+
+    while (!location_codes.empty())
+    {
+        parents.clear();
+        size_t num_kept = 0;
+
+        for (size_t i = 0; i < location_codes.size();)
+        {
+            const LocationCode location_code = location_codes[i];
+
+            if (location_code != 1 && (location_code & 7) == 0 && i + 7 < location_codes.size() &&
+                location_codes[i + 7] == location_code + 7)
+            {
+                parents.push_back(LocationCodes::parent_code(location_code));
+                i += 8;
+            }
+            else
+            {
+                location_codes[num_kept++] = location_code;
+                ++i;
+            }
+        }
+
+        for (size_t i = 0; i < num_kept; ++i)
+        {
+            set(location_codes[i]);
+        }
+
+        location_codes.swap(parents);
+    }
+}
+
+template <typename LocationCode, typename MapType>
+void OctreeBase<LocationCode, MapType>::integrate_scan(const Vertex& origin, const std::vector<Vertex>& points, uint8_t depth)
+{
+    depth = std::min<uint8_t>(depth, LocationCodes::max_depth());
+
+    const size_t num_chunks = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), points.size() / 64));
+    std::vector<std::vector<LocationCode>> chunk_free(num_chunks), chunk_hits(num_chunks);
+
+    parallel_for(0, num_chunks, [&](size_t chunk)
+    {
+        const size_t end = points.size() * (chunk + 1) / num_chunks;
+        for (size_t i = points.size() * chunk / num_chunks; i < end; ++i)
+        {
+            trace_ray(origin, points[i], depth, chunk_free[chunk], chunk_hits[chunk]);
+        }
+    }, 1);
+
+    std::vector<LocationCode> free_cells, hit_cells, scratch;
+    for (size_t chunk = 0; chunk < num_chunks; ++chunk)
+    {
+        free_cells.insert(free_cells.end(), chunk_free[chunk].begin(), chunk_free[chunk].end());
+        hit_cells.insert(hit_cells.end(), chunk_hits[chunk].begin(), chunk_hits[chunk].end());
+    }
+
+    // Rays from one origin overlap heavily near it, so deduplicate before
+    // touching the map
+    radix_sort(free_cells, scratch, 3 * depth + 1);
+    radix_sort(hit_cells, scratch, 3 * depth + 1);
+    free_cells.erase(std::unique(free_cells.begin(), free_cells.end()), free_cells.end());
+    hit_cells.erase(std::unique(hit_cells.begin(), hit_cells.end()), hit_cells.end());
+
+    scratch.clear();
+    std::set_difference(
+        free_cells.begin(), free_cells.end(), hit_cells.begin(), hit_cells.end(), std::back_inserter(scratch)
+    );
+
+    for (LocationCode location_code : scratch)
+    {
+        clear(location_code);
+    }
+
+    insert_sorted(hit_cells);
+}
+
+// 3D-DDA (Amanatides and Woo) over the cells at depth, clipped to the grid.
+// Steps move between neighbouring location codes directly.
+template <typename LocationCode, typename MapType>
+void OctreeBase<LocationCode, MapType>::trace_ray(
+    const Vertex& origin, const Vertex& end, uint8_t depth, std::vector<LocationCode>& free_cells,
+    std::vector<LocationCode>& hit_cells
+)
+{
+    const float grid_size = LocationCodes::cell_size(0);
+    const float cell_size = LocationCodes::cell_size(depth);
+    const uint32_t last = (uint32_t(1) << depth) - 1;
+
+    const float start[3] = {origin.x, origin.y, origin.z};
+    const float direction[3] = {end.x - origin.x, end.y - origin.y, end.z - origin.z};
+
+    float t_min = 0, t_max = 1;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (direction[axis] == 0)
+        {
+            if (start[axis] < 0 || start[axis] >= grid_size)
+            {
+                return;
+            }
+            continue;
+        }
+
+        const float t0 = -start[axis] / direction[axis];
+        const float t1 = (grid_size - start[axis]) / direction[axis];
+        t_min = std::max(t_min, std::min(t0, t1));
+        t_max = std::min(t_max, std::max(t0, t1));
+    }
+
+    if (t_min > t_max)
+    {
+        return;
+    }
+
+    uint32_t index[3], end_index[3], num_steps[3];
+    float next_t[3], delta_t[3];
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        const auto cell = [&](float t)
+        {
+            return std::min(last, uint32_t(std::max(0.0f, start[axis] + t * direction[axis]) / cell_size));
+        };
+
+        index[axis] = cell(t_min);
+        end_index[axis] = cell(t_max);
+        num_steps[axis] = (end_index[axis] > index[axis]) ? end_index[axis] - index[axis] : index[axis] - end_index[axis];
+
+        const float boundary = (index[axis] + (direction[axis] > 0)) * cell_size;
+        next_t[axis] = num_steps[axis] ? (boundary - start[axis]) / direction[axis] : INFINITY;
+        delta_t[axis] = num_steps[axis] ? cell_size / std::abs(direction[axis]) : INFINITY;
+    }
+
+    // Taking exactly the number of steps needed on each axis always lands on
+    // the end cell, whatever the rounding along the way
+    LocationCode location_code = LocationCodes::encode(depth, index[0], index[1], index[2]);
+
+    while (num_steps[0] + num_steps[1] + num_steps[2] > 0)
+    {
+        free_cells.push_back(location_code);
+
+        const int axis = (next_t[0] <= next_t[1])
+            ? (next_t[0] <= next_t[2] ? 0 : 2)
+            : (next_t[1] <= next_t[2] ? 1 : 2);
+
+        location_code = LocationCodes::neighbor_code(location_code, axis, direction[axis] > 0);
+        next_t[axis] = (--num_steps[axis] > 0) ? next_t[axis] + delta_t[axis] : INFINITY;
+    }
+
+    const bool end_inside = (t_max == 1) &&
+        end.x >= 0 && end.x < grid_size && end.y >= 0 && end.y < grid_size && end.z >= 0 && end.z < grid_size;
+    (end_inside ? hit_cells : free_cells).push_back(location_code);
+}
+
+template <typename LocationCode, typename MapType>
+bool OctreeBase<LocationCode, MapType>::is_set(LocationCode location_code) const
+{
+    const int depth = LocationCodes::depth(location_code);
+    NodeType node = get_node_unsafe(1);
+
+    if (depth == 0)
+    {
+        return node == ALL_CHILDREN_SET;
+    }
+
+    for (int level = 0; level < depth; ++level)
+    {
+        const LocationCode child_location_code = location_code >> 3 * (depth - level - 1);
+        const int child_index = LocationCodes::final_child_index(child_location_code);
+
+        if (!get_child_exists(node, child_index))
+        {
+            return get_child_set_if_not_exists(node, child_index);
+        }
+
+        node = get_node_unsafe(child_location_code);
+    }
+
+    return false; // The region itself is a node, so only partially set
 }
 
 template <typename LocationCode, typename MapType>
 NodeType* OctreeBase<LocationCode, MapType>::get_node_ptr(LocationCode location_code)
 {
+    OCTREE_STAT(_stats.record_probe(LocationCodes::depth(location_code)));
     const auto it = _nodes.find(location_code);
     return (it == _nodes.end()) ? nullptr : &(it->second);
 }
 
+template <typename LocationCode, typename MapType>
+NodeType* OctreeBase<LocationCode, MapType>::create_node(LocationCode location_code)
+{
+    if (_fill_cache_enabled)
+    {
+        invalidate_fill_cache(location_code);
+    }
+
+    const int depth = LocationCodes::depth(location_code);
+    NodeType* node = get_node_ptr(1);
+
+    for (int level = 0; level < depth; ++level)
+    {
+        const LocationCode child_location_code = location_code >> 3 * (depth - level - 1);
+        const int child_index = LocationCodes::final_child_index(child_location_code);
+
+        if (get_child_exists(*node, child_index))
+        {
+            node = get_node_ptr(child_location_code);
+        }
+        else if (get_child_set_if_not_exists(*node, child_index))
+        {
+            return nullptr;
+        }
+        else
+        {
+            set_child_exists(*node, child_index);
+            node = &_nodes.emplace(child_location_code, 0).first->second;
+        }
+    }
+
+    return node;
+}
+
 template <typename LocationCode, typename MapType>
 OptionalNodeType OctreeBase<LocationCode, MapType>::get_node(LocationCode location_code) const
 {
+    OCTREE_STAT(_stats.record_probe(LocationCodes::depth(location_code)));
     const auto it = _nodes.find(location_code);
     return (it == _nodes.end()) ? std::nullopt : OptionalNodeType(it->second);
 }
@@ -159,55 +646,1060 @@ OptionalNodeType OctreeBase<LocationCode, MapType>::get_node(LocationCode locati
 template <typename LocationCode, typename MapType>
 NodeType OctreeBase<LocationCode, MapType>::get_node_unsafe(LocationCode location_code) const
 {
+    OCTREE_STAT(_stats.record_probe(LocationCodes::depth(location_code)));
     return _nodes.find(location_code)->second;
 }
 
 template <typename LocationCode, typename MapType>
 float OctreeBase<LocationCode, MapType>::get_volume() const
 {
-    constexpr LocationCode biggest = 1 << (8 * sizeof(LocationCode) - 1);
-    return (float)get_node_volume(1, biggest >> 3) / biggest;
+    constexpr LocationCode biggest = LocationCode(1) << (8 * sizeof(LocationCode) - 1);
+    return (float)get_node_volume(1) / biggest;
 }
 
 template <typename LocationCode, typename MapType>
-void OctreeBase<LocationCode, MapType>::erase_node(LocationCode location_code)
+float OctreeBase<LocationCode, MapType>::get_fill_fraction(LocationCode location_code) const
 {
-    const auto it = _nodes.find(location_code);
-    if (it == _nodes.end())
-    {
-        return;
-    }
+    const int depth = LocationCodes::depth(location_code);
+    NodeType node = get_node_unsafe(1);
 
-    for (int i = 0; i < 8; ++i)
+    for (int level = 0; level < depth; ++level)
     {
-        if (get_child_exists(it->second, i))
+        const LocationCode child_location_code = location_code >> 3 * (depth - level - 1);
+        const int child_index = LocationCodes::final_child_index(child_location_code);
+
+        if (!get_child_exists(node, child_index))
         {
-            erase_node(LocationCodes::child_code(location_code, i));
+            return get_child_set_if_not_exists(node, child_index) ? 1.0f : 0.0f;
         }
+
+        node = get_node_unsafe(child_location_code);
     }
 
-    _nodes.erase(it);
+    const LocationCode region_volume = (LocationCode(1) << (8 * sizeof(LocationCode) - 1)) >> 3 * depth;
+    const LocationCode volume = _fill_cache_enabled ? get_cached_node_volume(location_code) : get_node_volume(location_code);
+    return (float)((double)volume / (double)region_volume);
+}
+
+template <typename LocationCode, typename MapType>
+void OctreeBase<LocationCode, MapType>::enable_fill_cache(bool enabled)
+{
+    _fill_cache_enabled = enabled;
+    _fill_cache.clear();
 }
 
+// Only the invalidated path is recomputed; sibling subtrees hit the cache
 template <typename LocationCode, typename MapType>
-LocationCode OctreeBase<LocationCode, MapType>::get_node_volume(LocationCode location_code, LocationCode child_volume) const
+LocationCode OctreeBase<LocationCode, MapType>::get_cached_node_volume(LocationCode location_code) const
 {
-    const std::optional<NodeType> node = get_node(location_code);
-    LocationCode result = 0;
+    const auto it = _fill_cache.find(location_code);
+    if (it != _fill_cache.end())
+    {
+        return it->second;
+    }
+
+    const NodeType node = get_node_unsafe(location_code);
+    const LocationCode child_volume = (LocationCode(1) << (8 * sizeof(LocationCode) - 1)) >> 3 * (LocationCodes::depth(location_code) + 1);
+    LocationCode volume = 0;
 
     for (int i = 0; i < 8; ++i)
     {
-        if (get_child_exists(node.value(), i))
+        if (get_child_exists(node, i))
         {
-            result += get_node_volume(LocationCodes::child_code(location_code, i), child_volume >> 3);
+            volume += get_cached_node_volume(LocationCodes::child_code(location_code, i));
         }
-        else if (get_child_set_if_not_exists(node.value(), i))
+        else if (get_child_set_if_not_exists(node, i))
         {
-            result += child_volume;
+            volume += child_volume;
         }
     }
 
-    return result;
+    _fill_cache.emplace(location_code, volume);
+    return volume;
+}
+
+// Drops the entries along the ancestor path; erase_node() drops those of the
+// erased subtree, so the cache never outgrows the node map.
+template <typename LocationCode, typename MapType>
+void OctreeBase<LocationCode, MapType>::invalidate_fill_cache(LocationCode location_code)
+{
+    for (; location_code != 0; location_code = LocationCodes::parent_code(location_code))
+    {
+        _fill_cache.erase(location_code);
+    }
+}
+
+template <typename LocationCode, typename MapType>
+float OctreeBase<LocationCode, MapType>::get_surface_area() const
+{
+    const uint64_t area = _surface_tracking_enabled ? _surface_area : get_content_surface(1);
+    return (float)((double)area / (double)get_face_area(0));
+}
+
+template <typename LocationCode, typename MapType>
+void OctreeBase<LocationCode, MapType>::enable_surface_tracking(bool enabled)
+{
+    _surface_tracking_enabled = enabled;
+    _surface_area = enabled ? get_content_surface(1) : 0;
+}
+
+// The surface is the sum of the face areas of the set regions minus twice
+// the contact area between them, so a change only affects the terms of the
+// regions in and touching the changed region: the old ones are subtracted,
+// then the new ones added.
+template <typename LocationCode, typename MapType>
+void OctreeBase<LocationCode, MapType>::track_surface_change(LocationCode location_code, bool value)
+{
+    if (value && is_set(location_code))
+    {
+        return;
+    }
+
+    const uint64_t removed = get_content_surface(location_code);
+
+    _surface_tracking_enabled = false;
+    value ? set(location_code) : clear(location_code);
+    _surface_tracking_enabled = true;
+
+    if (location_code == 1)
+    {
+        // set_root() and clear_root() have already reset the area
+        _surface_area = value ? get_exposed_surface(1) : 0;
+        return;
+    }
+
+    _surface_area = _surface_area - removed + (value ? get_exposed_surface(location_code) : 0);
+}
+
+// Faces of the set content of the region, minus twice its contacts with set
+// regions outside it and once (from each side) those inside it
+template <typename LocationCode, typename MapType>
+uint64_t OctreeBase<LocationCode, MapType>::get_content_surface(LocationCode location_code) const
+{
+    std::vector<LocationCode> contents;
+
+    if (is_set(location_code))
+    {
+        contents.push_back(location_code);
+    }
+    else if (get_node(location_code))
+    {
+        struct Visitor : OctreeVisitor<LocationCode>
+        {
+            Visitor(std::vector<LocationCode>& contents) : contents(contents) {}
+
+            void set_child(LocationCode child_location_code) { contents.push_back(child_location_code); }
+
+            std::vector<LocationCode>& contents;
+        } visitor(contents);
+
+        traverse(visitor, location_code);
+    }
+
+    const int depth = LocationCodes::depth(location_code);
+    uint64_t area = 0;
+
+    for (LocationCode region : contents)
+    {
+        const int region_depth = LocationCodes::depth(region);
+        area += 6 * get_face_area(region_depth);
+
+        const auto contact = [&](LocationCode other)
+        {
+            const int other_depth = LocationCodes::depth(other);
+            const bool inside = other_depth >= depth && (other >> 3 * (other_depth - depth)) == location_code;
+            area -= (inside ? 1 : 2) * get_face_area(std::max(region_depth, other_depth));
+        };
+
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            for (int sign : {-1, 1})
+            {
+                const LocationCode neighbor = LocationCodes::neighbor_code(region, axis, sign > 0);
+                if (neighbor != 0)
+                {
+                    std::array<int, 3> offset = {0, 0, 0};
+                    offset[axis] = sign;
+                    for_each_set_touching(neighbor, offset, contact);
+                }
+            }
+        }
+    }
+
+    return area;
+}
+
+// Surface terms of the region as a single set block
+template <typename LocationCode, typename MapType>
+uint64_t OctreeBase<LocationCode, MapType>::get_exposed_surface(LocationCode location_code) const
+{
+    const int depth = LocationCodes::depth(location_code);
+    uint64_t area = 6 * get_face_area(depth);
+
+    const auto contact = [&](LocationCode other)
+    {
+        area -= 2 * get_face_area(std::max<int>(depth, LocationCodes::depth(other)));
+    };
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        for (int sign : {-1, 1})
+        {
+            const LocationCode neighbor = LocationCodes::neighbor_code(location_code, axis, sign > 0);
+            if (neighbor != 0)
+            {
+                std::array<int, 3> offset = {0, 0, 0};
+                offset[axis] = sign;
+                for_each_set_touching(neighbor, offset, contact);
+            }
+        }
+    }
+
+    return area;
+}
+
+template <typename LocationCode, typename MapType>
+OctreeBase<LocationCode, MapType> OctreeBase<LocationCode, MapType>::coarsen(uint8_t depth, CoarsenPolicy policy) const
+{
+    depth = std::min<uint8_t>(depth, LocationCodes::max_depth());
+    OctreeBase result(false);
+
+    // One pass over the nodes in any order. Set children at or above depth are
+    // copied as they are; deeper ones add their volume, in max-depth cells,
+    // to the cell at depth containing them.
+    std::unordered_map<LocationCode, uint64_t> set_volumes;
+
+    for (const auto& [location_code, node] : _nodes)
+    {
+        const int child_depth = LocationCodes::depth(location_code) + 1;
+        const int num_set = bit_count((node >> 8) & ~node & 0xff);
+
+        if (num_set == 0)
+        {
+            continue;
+        }
+
+        if (child_depth <= depth)
+        {
+            for (int i = 0; i < 8; ++i)
+            {
+                if (get_child_set(node, i))
+                {
+                    result.set(LocationCodes::child_code(location_code, i));
+                }
+            }
+        }
+        else
+        {
+            const LocationCode cell_code = location_code >> 3 * (child_depth - 1 - depth);
+            set_volumes[cell_code] += uint64_t(num_set) << 3 * (LocationCodes::max_depth() - child_depth);
+        }
+    }
+
+    const uint64_t cell_volume = uint64_t(1) << 3 * (LocationCodes::max_depth() - depth);
+    std::vector<LocationCode> cells;
+
+    for (const auto& [cell_code, set_volume] : set_volumes)
+    {
+        if (policy == CoarsenPolicy::ANY ||
+            (policy == CoarsenPolicy::MAJORITY && 2 * set_volume > cell_volume) ||
+            set_volume == cell_volume)
+        {
+            cells.push_back(cell_code);
+        }
+    }
+
+    std::sort(cells.begin(), cells.end());
+    result.insert_sorted(cells);
+
+    return result;
+}
+
+template <typename LocationCode, typename MapType>
+ComponentLabeling<LocationCode> OctreeBase<LocationCode, MapType>::label_components(Connectivity connectivity) const
+{
+    ComponentLabeling<LocationCode> labeling;
+    for_each_set([&](LocationCode location_code, uint8_t) { labeling.regions.push_back(location_code); });
+
+    const std::vector<LocationCode>& regions = labeling.regions;
+    std::unordered_map<LocationCode, uint32_t> region_index;
+    region_index.reserve(regions.size());
+    for (uint32_t i = 0; i < regions.size(); ++i)
+    {
+        region_index.emplace(regions[i], i);
+    }
+
+    // Union-find with path halving and union by size
+    std::vector<uint32_t> parents(regions.size()), sizes(regions.size(), 1);
+    std::iota(parents.begin(), parents.end(), 0);
+
+    const auto find = [&](uint32_t i)
+    {
+        while (parents[i] != i)
+        {
+            parents[i] = parents[parents[i]];
+            i = parents[i];
+        }
+        return i;
+    };
+
+    const auto unite = [&](uint32_t a, uint32_t b)
+    {
+        a = find(a);
+        b = find(b);
+        if (a != b)
+        {
+            if (sizes[a] < sizes[b])
+            {
+                std::swap(a, b);
+            }
+            parents[b] = a;
+            sizes[a] += sizes[b];
+        }
+    };
+
+    const std::vector<std::array<int, 3>> offsets = neighbor_offsets(connectivity);
+
+    // A region finds every set region at least as large that touches it by
+    // walking up from its same-size neighbours. Smaller regions touching it
+    // find it the same way, so nothing needs to look downwards.
+    for (uint32_t i = 0; i < regions.size(); ++i)
+    {
+        for (const std::array<int, 3>& offset : offsets)
+        {
+            LocationCode neighbor = regions[i];
+            for (int axis = 0; axis < 3 && neighbor != 0; ++axis)
+            {
+                if (offset[axis] != 0)
+                {
+                    neighbor = LocationCodes::neighbor_code(neighbor, axis, offset[axis] > 0);
+                }
+            }
+
+            // Stop below the common ancestor, which cannot be a set region
+            for (LocationCode own = regions[i]; neighbor != 0 && neighbor != own; neighbor >>= 3, own >>= 3)
+            {
+                const auto it = region_index.find(neighbor);
+                if (it != region_index.end())
+                {
+                    unite(i, it->second);
+                    break;
+                }
+            }
+        }
+    }
+
+    std::vector<uint32_t> root_labels(regions.size(), UINT32_MAX);
+    labeling.labels.resize(regions.size());
+    for (uint32_t i = 0; i < regions.size(); ++i)
+    {
+        uint32_t& label = root_labels[find(i)];
+        if (label == UINT32_MAX)
+        {
+            label = labeling.num_components++;
+        }
+        labeling.labels[i] = label;
+    }
+
+    return labeling;
+}
+
+// Steps to the neighbours sharing a face, and also an edge or a corner
+template <typename LocationCode, typename MapType>
+std::vector<std::array<int, 3>> OctreeBase<LocationCode, MapType>::neighbor_offsets(Connectivity connectivity)
+{
+    const int max_axes = (connectivity == Connectivity::FACES) ? 1 : (connectivity == Connectivity::EDGES) ? 2 : 3;
+    std::vector<std::array<int, 3>> offsets;
+
+    for (int dx = -1; dx <= 1; ++dx)
+    {
+        for (int dy = -1; dy <= 1; ++dy)
+        {
+            for (int dz = -1; dz <= 1; ++dz)
+            {
+                const int num_axes = (dx != 0) + (dy != 0) + (dz != 0);
+                if (num_axes > 0 && num_axes <= max_axes)
+                {
+                    offsets.push_back({dx, dy, dz});
+                }
+            }
+        }
+    }
+
+    return offsets;
+}
+
+template <typename LocationCode, typename MapType>
+OctreeBase<LocationCode, MapType> OctreeBase<LocationCode, MapType>::flood_fill(const GridPoint& seed, Connectivity connectivity) const
+{
+    OctreeBase result(false);
+    const OctreeBase empty_space = complement();
+
+    const uint32_t grid_size = LocationCodes::cell_size(0);
+    if (seed.x >= grid_size || seed.y >= grid_size || seed.z >= grid_size)
+    {
+        throw std::runtime_error("flood_fill seed lies outside the grid");
+    }
+
+    // The unset region holding the seed
+    const uint32_t cell_size = LocationCodes::cell_size(LocationCodes::max_depth());
+    const LocationCode seed_code = LocationCodes::encode(
+        LocationCodes::max_depth(), seed.x / cell_size, seed.y / cell_size, seed.z / cell_size
+    );
+
+    std::optional<LocationCode> start;
+    const std::array<int, 3> no_offset = {0, 0, 0};
+    const auto found_start = [&](LocationCode location_code) { start = location_code; };
+    empty_space.for_each_set_touching(seed_code, no_offset, found_start);
+
+    if (!start)
+    {
+        return result;
+    }
+
+    const std::vector<std::array<int, 3>> offsets = neighbor_offsets(connectivity);
+
+    // Depth-first, since the order regions are reached in does not matter
+    std::unordered_set<LocationCode> reached = {*start};
+    std::vector<LocationCode> stack = {*start};
+
+    while (!stack.empty())
+    {
+        const LocationCode location_code = stack.back();
+        stack.pop_back();
+        result.set(location_code);
+
+        const auto visit = [&](LocationCode neighbor)
+        {
+            if (reached.insert(neighbor).second)
+            {
+                stack.push_back(neighbor);
+            }
+        };
+
+        for (const std::array<int, 3>& offset : offsets)
+        {
+            LocationCode neighbor = location_code;
+            for (int axis = 0; axis < 3 && neighbor != 0; ++axis)
+            {
+                if (offset[axis] != 0)
+                {
+                    neighbor = LocationCodes::neighbor_code(neighbor, axis, offset[axis] > 0);
+                }
+            }
+
+            if (neighbor != 0)
+            {
+                empty_space.for_each_set_touching(neighbor, offset, visit);
+            }
+        }
+    }
+
+    return result;
+}
+
+// Calls function(code) for the set region covering location_code, or else for
+// each set region inside it that touches the side facing back along offset
+template <typename LocationCode, typename MapType>
+template <typename Function>
+void OctreeBase<LocationCode, MapType>::for_each_set_touching(
+    LocationCode location_code, const std::array<int, 3>& offset, Function& function
+) const
+{
+    const int depth = LocationCodes::depth(location_code);
+    NodeType node = get_node_unsafe(1);
+
+    for (int level = 0; level < depth; ++level)
+    {
+        const LocationCode child_location_code = location_code >> 3 * (depth - level - 1);
+        const int child_index = LocationCodes::final_child_index(child_location_code);
+
+        if (!get_child_exists(node, child_index))
+        {
+            if (get_child_set_if_not_exists(node, child_index))
+            {
+                function(child_location_code);
+            }
+            return;
+        }
+
+        node = get_node_unsafe(child_location_code);
+    }
+
+    // Subdivided: only children on the facing side along each offset axis
+    struct Visitor : OctreeVisitor<LocationCode>
+    {
+        Visitor(const std::array<int, 3>& offset, Function& function) : offset(offset), function(function) {}
+
+        bool facing(LocationCode child_location_code) const
+        {
+            const int child_index = LocationCodes::final_child_index(child_location_code);
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                const int bit = (child_index >> axis) & 1;
+                if ((offset[axis] > 0 && bit != 0) || (offset[axis] < 0 && bit != 1))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        void set_child(LocationCode child_location_code)
+        {
+            if (facing(child_location_code))
+            {
+                function(child_location_code);
+            }
+        }
+
+        bool prune(LocationCode child_location_code) { return !facing(child_location_code); }
+
+        const std::array<int, 3>& offset;
+        Function& function;
+    } visitor(offset, function);
+
+    traverse(visitor, location_code);
+}
+
+template <typename LocationCode, typename MapType>
+OctreeBase<LocationCode, MapType> OctreeBase<LocationCode, MapType>::complement() const
+{
+    OctreeBase result(*this);
+
+    // Nodes keep their place; uniform children swap between set and unset.
+    // Only the root can be empty or full, so collapse invariants still hold.
+    for (auto& [location_code, node] : result._nodes)
+    {
+        const NodeType exists = node & 0xff;
+        node = exists | ((~(node >> 8) & ~exists & 0xff) << 8);
+    }
+    result._fill_cache.clear();
+    if (result._surface_tracking_enabled)
+    {
+        result.enable_surface_tracking(true);
+    }
+
+    return result;
+}
+
+template <typename LocationCode, typename MapType>
+OctreeBase<LocationCode, MapType> OctreeBase<LocationCode, MapType>::dilate(uint32_t radius, uint8_t depth, MorphologyElement element) const
+{
+    depth = std::min<uint8_t>(depth, LocationCodes::max_depth());
+    OctreeBase result = coarsen(depth, CoarsenPolicy::ANY);
+
+    if (radius == 0)
+    {
+        return result;
+    }
+
+    std::vector<LocationCode> regions;
+    result.for_each_set([&](LocationCode location_code, uint8_t) { regions.push_back(location_code); });
+
+    // Each thread dilates a contiguous Morton range into its own tree
+    const size_t num_chunks = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), regions.size() / 64));
+    std::vector<OctreeBase> partials(num_chunks, OctreeBase(false));
+
+    parallel_for(0, num_chunks, [&](size_t chunk)
+    {
+        const size_t end = regions.size() * (chunk + 1) / num_chunks;
+        for (size_t i = regions.size() * chunk / num_chunks; i < end; ++i)
+        {
+            add_dilation(partials[chunk], regions[i], radius, depth, element);
+        }
+    }, 1);
+
+    for (const OctreeBase& partial : partials)
+    {
+        partial.for_each_set([&](LocationCode location_code, uint8_t) { result.set(location_code); });
+    }
+
+    return result;
+}
+
+template <typename LocationCode, typename MapType>
+OctreeBase<LocationCode, MapType> OctreeBase<LocationCode, MapType>::erode(uint32_t radius, uint8_t depth, MorphologyElement element) const
+{
+    depth = std::min<uint8_t>(depth, LocationCodes::max_depth());
+    OctreeBase dilated = complement().dilate(radius, depth, element);
+
+    // Space outside the grid is unset, so it erodes a border of the grid too
+    const int64_t last = int64_t(1) << depth;
+    const int64_t r = std::min<int64_t>(radius, last);
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        int64_t min[3] = {0, 0, 0}, max[3] = {last, last, last};
+        max[axis] = r;
+        set_cell_box(dilated, min, max, depth);
+
+        min[axis] = last - r;
+        max[axis] = last;
+        set_cell_box(dilated, min, max, depth);
+    }
+
+    return dilated.complement();
+}
+
+// Adds the cells within radius of the region but outside it: for the cube,
+// six slabs; for the sphere, face slabs plus the rounded edge lines and
+// corner cells.
+template <typename LocationCode, typename MapType>
+void OctreeBase<LocationCode, MapType>::add_dilation(
+    OctreeBase& octree, LocationCode location_code, uint32_t radius, uint8_t depth, MorphologyElement element
+)
+{
+    const GridPoint corner = LocationCodes::lower_corner_point(location_code);
+    const uint32_t cell_size = LocationCodes::cell_size(depth);
+    const int64_t extent = LocationCodes::cell_size(LocationCodes::depth(location_code)) / cell_size;
+    const int64_t lo[3] = {corner.x / cell_size, corner.y / cell_size, corner.z / cell_size};
+    const int64_t hi[3] = {lo[0] + extent, lo[1] + extent, lo[2] + extent};
+    const int64_t r = radius;
+
+    if (element == MorphologyElement::CUBE)
+    {
+        // Slabs along x span the grown box; along y and z they shrink to
+        // avoid covering earlier slabs again
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            int64_t min[3], max[3];
+            for (int other = 0; other < 3; ++other)
+            {
+                min[other] = (other > axis) ? lo[other] - r : lo[other];
+                max[other] = (other > axis) ? hi[other] + r : hi[other];
+            }
+
+            min[axis] = lo[axis] - r;
+            max[axis] = lo[axis];
+            set_cell_box(octree, min, max, depth);
+
+            min[axis] = hi[axis];
+            max[axis] = hi[axis] + r;
+            set_cell_box(octree, min, max, depth);
+        }
+        return;
+    }
+
+    // Cell index at distance outside the region along axis, on the given side
+    const auto outside = [&](int axis, int sign, int64_t distance)
+    {
+        return sign < 0 ? lo[axis] - distance : hi[axis] - 1 + distance;
+    };
+
+    // Each non-empty mask of axes picks the part of the shell lying outside
+    // the region along exactly those axes
+    for (int mask = 1; mask < 8; ++mask)
+    {
+        const int num_outside = bit_count(mask);
+        int axes[3], num_axes = 0;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            if (mask & (1 << axis))
+            {
+                axes[num_axes++] = axis;
+            }
+        }
+
+        for (int signs = 0; signs < (1 << num_outside); ++signs)
+        {
+            const auto sign = [&](int k) { return (signs & (1 << k)) ? 1 : -1; };
+
+            if (num_outside == 1)
+            {
+                int64_t min[3] = {lo[0], lo[1], lo[2]}, max[3] = {hi[0], hi[1], hi[2]};
+                const int axis = axes[0];
+                min[axis] = sign(0) < 0 ? lo[axis] - r : hi[axis];
+                max[axis] = sign(0) < 0 ? lo[axis] : hi[axis] + r;
+                set_cell_box(octree, min, max, depth);
+                continue;
+            }
+
+            for (int64_t da = 1; da <= r; ++da)
+            {
+                for (int64_t db = 1; da * da + db * db <= r * r; ++db)
+                {
+                    if (num_outside == 2)
+                    {
+                        int64_t min[3] = {lo[0], lo[1], lo[2]}, max[3] = {hi[0], hi[1], hi[2]};
+                        min[axes[0]] = outside(axes[0], sign(0), da);
+                        max[axes[0]] = min[axes[0]] + 1;
+                        min[axes[1]] = outside(axes[1], sign(1), db);
+                        max[axes[1]] = min[axes[1]] + 1;
+                        set_cell_box(octree, min, max, depth);
+                        continue;
+                    }
+
+                    for (int64_t dc = 1; da * da + db * db + dc * dc <= r * r; ++dc)
+                    {
+                        const int64_t min[3] = {outside(0, sign(0), da), outside(1, sign(1), db), outside(2, sign(2), dc)};
+                        const int64_t max[3] = {min[0] + 1, min[1] + 1, min[2] + 1};
+                        set_cell_box(octree, min, max, depth);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Box in units of cells at depth, clipped to the grid
+template <typename LocationCode, typename MapType>
+void OctreeBase<LocationCode, MapType>::set_cell_box(OctreeBase& octree, const int64_t (&min)[3], const int64_t (&max)[3], uint8_t depth)
+{
+    const int64_t resolution = int64_t(1) << depth;
+    const uint32_t cell_size = LocationCodes::cell_size(depth);
+    uint32_t clipped_min[3], clipped_max[3];
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        clipped_min[axis] = uint32_t(std::clamp<int64_t>(min[axis], 0, resolution)) * cell_size;
+        clipped_max[axis] = uint32_t(std::clamp<int64_t>(max[axis], 0, resolution)) * cell_size;
+        if (clipped_min[axis] >= clipped_max[axis])
+        {
+            return;
+        }
+    }
+
+    octree.set_box(
+        GridPoint{clipped_min[0], clipped_min[1], clipped_min[2]}, GridPoint{clipped_max[0], clipped_max[1], clipped_max[2]}
+    );
+}
+
+template <typename LocationCode, typename MapType>
+MemoryUsage OctreeBase<LocationCode, MapType>::memory_usage() const
+{
+    MemoryUsage usage;
+    MapType::add_memory_usage(_nodes, usage);
+
+    usage.nodes_per_depth.resize(get_max_depth());
+    for (const auto& kv : _nodes)
+    {
+        ++usage.nodes_per_depth[LocationCodes::depth(kv.first)];
+    }
+
+    return usage;
+}
+
+template <typename LocationCode, typename MapType>
+std::vector<LocationCode> OctreeBase<LocationCode, MapType>::query_box(const GridPoint& min, const GridPoint& max) const
+{
+    struct Visitor : OctreeVisitor<LocationCode>
+    {
+        Visitor(const GridPoint& min, const GridPoint& max) : min(min), max(max) {}
+
+        void set_child(LocationCode location_code)
+        {
+            if (box_overlap(location_code, min, max) != 0)
+            {
+                result.push_back(location_code);
+            }
+        }
+
+        bool prune(LocationCode location_code)
+        {
+            return box_overlap(location_code, min, max) == 0;
+        }
+
+        const GridPoint& min;
+        const GridPoint& max;
+        std::vector<LocationCode> result;
+    } visitor(min, max);
+
+    traverse(visitor);
+    return std::move(visitor.result);
+}
+
+template <typename LocationCode, typename MapType>
+float OctreeBase<LocationCode, MapType>::volume_in_box(const GridPoint& min, const GridPoint& max) const
+{
+    struct Visitor : OctreeVisitor<LocationCode>
+    {
+        Visitor(const GridPoint& min, const GridPoint& max) : min(min), max(max) {}
+
+        void set_child(LocationCode location_code)
+        {
+            num_cells += box_overlap(location_code, min, max);
+        }
+
+        bool prune(LocationCode location_code)
+        {
+            return box_overlap(location_code, min, max) == 0;
+        }
+
+        const GridPoint& min;
+        const GridPoint& max;
+        uint64_t num_cells = 0;
+    } visitor(min, max);
+
+    traverse(visitor);
+    return (float)((double)visitor.num_cells / (double)(uint64_t(1) << 3 * get_max_depth()));
+}
+
+template <typename LocationCode, typename MapType>
+std::optional<typename OctreeBase<LocationCode, MapType>::NearestSet> OctreeBase<LocationCode, MapType>::nearest_set(const Vertex& point, float max_radius) const
+{
+    struct Candidate
+    {
+        float distance_sq;
+        LocationCode location_code;
+        bool is_set;
+
+        bool operator>(const Candidate& other) const { return distance_sq > other.distance_sq; }
+    };
+
+    std::vector<Candidate> storage;
+    storage.reserve(64);
+    std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> queue(
+        std::greater<Candidate>(), std::move(storage)
+    );
+
+    // Box distance is a lower bound for everything inside a node, so the
+    // first set region popped is the nearest one.
+    const float max_distance_sq = max_radius * max_radius;
+    queue.push({0, 1, false});
+
+    while (!queue.empty())
+    {
+        const Candidate candidate = queue.top();
+        queue.pop();
+
+        if (candidate.is_set)
+        {
+            return NearestSet{candidate.location_code, std::sqrt(candidate.distance_sq)};
+        }
+
+        const NodeType node = get_node_unsafe(candidate.location_code);
+
+        for (int i = 0; i < 8; ++i)
+        {
+            const bool is_set = get_child_set(node, i);
+            if (!is_set && !get_child_exists(node, i))
+            {
+                continue;
+            }
+
+            const LocationCode child_code = LocationCodes::child_code(candidate.location_code, i);
+            const float distance_sq = box_distance_sq(child_code, point);
+
+            if (distance_sq <= max_distance_sq)
+            {
+                queue.push({distance_sq, child_code, is_set});
+            }
+        }
+    }
+
+    return std::nullopt;
+}
+
+template <typename LocationCode, typename MapType>
+std::optional<float> OctreeBase<LocationCode, MapType>::raycast(const Vertex& origin, const Vertex& direction, float max_distance) const
+{
+    struct Accessor
+    {
+        using Handle = LocationCode;
+
+        Handle root() const { return 1; }
+        NodeType node(Handle handle) const { return tree.get_node_unsafe(handle); }
+        Handle child(Handle handle, NodeType node, int child_index) const { return LocationCodes::child_code(handle, child_index); }
+
+        const OctreeBase& tree;
+    } accessor{*this};
+
+    return RayCaster<LocationCodes, Accessor>(accessor, origin, direction, max_distance).cast();
+}
+
+template <typename LocationCode, typename MapType>
+float OctreeBase<LocationCode, MapType>::box_distance_sq(LocationCode location_code, const Vertex& point)
+{
+    const GridPoint corner = LocationCodes::lower_corner_point(location_code);
+    const float size = LocationCodes::cell_size(LocationCodes::depth(location_code));
+
+    const auto axis_distance = [size](float lower, float value)
+    {
+        return std::max({lower - value, 0.0f, value - (lower + size)});
+    };
+
+    const float dx = axis_distance(corner.x, point.x);
+    const float dy = axis_distance(corner.y, point.y);
+    const float dz = axis_distance(corner.z, point.z);
+
+    return dx * dx + dy * dy + dz * dz;
+}
+
+template <typename LocationCode, typename MapType>
+uint64_t OctreeBase<LocationCode, MapType>::box_overlap(LocationCode location_code, const GridPoint& min, const GridPoint& max)
+{
+    // Number of max-depth cells shared by the node and the box
+    const GridPoint corner = LocationCodes::lower_corner_point(location_code);
+    const uint32_t size = LocationCodes::cell_size(LocationCodes::depth(location_code));
+
+    const auto overlap = [size](uint32_t lower, uint32_t box_min, uint32_t box_max) -> uint64_t
+    {
+        const uint32_t start = std::max(lower, box_min);
+        const uint32_t end = std::min(lower + size, box_max);
+        return (start < end) ? end - start : 0;
+    };
+
+    return overlap(corner.x, min.x, max.x) * overlap(corner.y, min.y, max.y) * overlap(corner.z, min.z, max.z);
+}
+
+template <typename LocationCode, typename MapType>
+template <typename Visitor>
+void OctreeBase<LocationCode, MapType>::traverse(Visitor& visitor, LocationCode location_code) const
+{
+    OCTREE_STAT(_stats.record_probe(LocationCodes::depth(location_code)));
+    const auto it = _nodes.find(location_code);
+    if (it == _nodes.end())
+    {
+        return;
+    }
+
+    TraversalStack stack;
+    size_t size = 0;
+
+    stack[size++] = TraversalFrame{location_code, it->second, 0};
+    visitor.enter_node(location_code, it->second);
+
+    while (size > 0)
+    {
+        TraversalFrame& frame = stack[size - 1];
+
+        const unsigned remaining = ((frame.node | (frame.node >> 8)) & 0xff) >> frame.next_child;
+        if (remaining == 0)
+        {
+            visitor.exit_node(frame.location_code, frame.node);
+            --size;
+            continue;
+        }
+
+        const int i = frame.next_child + low_bit_index(remaining);
+        frame.next_child = i + 1;
+        const LocationCode child_code = LocationCodes::child_code(frame.location_code, i);
+
+        if (!get_child_exists(frame.node, i))
+        {
+            visitor.set_child(child_code);
+        }
+        else if (!visitor.prune(child_code))
+        {
+            const NodeType child_node = get_node_unsafe(child_code);
+            stack[size++] = TraversalFrame{child_code, child_node, 0};
+            visitor.enter_node(child_code, child_node);
+        }
+    }
+}
+
+template <typename LocationCode, typename MapType>
+void OctreeBase<LocationCode, MapType>::erase_node(LocationCode location_code)
+{
+    struct Visitor : OctreeVisitor<LocationCode>
+    {
+        Visitor(NodeMapType& nodes, std::unordered_map<LocationCode, LocationCode>* fill_cache) :
+            nodes(nodes),
+            fill_cache(fill_cache)
+        {
+        }
+
+        void exit_node(LocationCode location_code, NodeType node)
+        {
+            nodes.erase(location_code);
+            if (fill_cache)
+            {
+                fill_cache->erase(location_code);
+            }
+            OCTREE_STAT(++num_erased);
+        }
+
+        NodeMapType& nodes;
+        std::unordered_map<LocationCode, LocationCode>* fill_cache;
+        uint64_t num_erased = 0;
+    } visitor(_nodes, _fill_cache_enabled ? &_fill_cache : nullptr);
+
+    traverse(visitor, location_code);
+    OCTREE_STAT(_stats.record_erase(visitor.num_erased));
+}
+
+template <typename LocationCode, typename MapType>
+LocationCode OctreeBase<LocationCode, MapType>::get_node_volume(LocationCode location_code) const
+{
+    struct Visitor : OctreeVisitor<LocationCode>
+    {
+        void set_child(LocationCode location_code)
+        {
+            // The root has volume 2^(bits - 1), and each level divides it by 8
+            volume += (LocationCode(1) << (8 * sizeof(LocationCode) - 1)) >> 3 * LocationCodes::depth(location_code);
+        }
+
+        LocationCode volume = 0;
+    } visitor;
+
+    traverse(visitor, location_code);
+    return visitor.volume;
+}
+
+template <typename LocationCode, typename MapType>
+OctreeBase<LocationCode, MapType>::SetRegionIterator::SetRegionIterator(const OctreeBase* tree) :
+    _tree(tree),
+    _size(0),
+    _current{0, 0}
+{
+    push(1);
+    advance();
+}
+
+template <typename LocationCode, typename MapType>
+void OctreeBase<LocationCode, MapType>::SetRegionIterator::push(LocationCode location_code)
+{
+    _stack[_size++] = TraversalFrame{location_code, _tree->get_node_unsafe(location_code), 0};
+}
+
+template <typename LocationCode, typename MapType>
+void OctreeBase<LocationCode, MapType>::SetRegionIterator::advance()
+{
+    while (_size > 0)
+    {
+        TraversalFrame& frame = _stack[_size - 1];
+
+        // Skip straight to the next child that is either set or exists
+        const unsigned remaining = ((frame.node | (frame.node >> 8)) & 0xff) >> frame.next_child;
+        if (remaining == 0)
+        {
+            --_size;
+            continue;
+        }
+
+        const int i = frame.next_child + low_bit_index(remaining);
+        frame.next_child = i + 1;
+        const LocationCode child_code = LocationCodes::child_code(frame.location_code, i);
+
+        if (get_child_exists(frame.node, i))
+        {
+            push(child_code);
+        }
+        else
+        {
+            _current = {child_code, (uint8_t)_size};
+            return;
+        }
+    }
+}
+
+template <typename LocationCode, typename MapType>
+template <typename Function>
+void OctreeBase<LocationCode, MapType>::for_each_set(Function&& function) const
+{
+    struct Visitor : OctreeVisitor<LocationCode>
+    {
+        Visitor(Function& function) : function(function) {}
+
+        void set_child(LocationCode location_code)
+        {
+            function(location_code, LocationCodes::depth(location_code));
+        }
+
+        Function& function;
+    } visitor(function);
+
+    traverse(visitor);
 }
 
 template <typename LocationCode, typename MapType>
@@ -0,0 +1,228 @@
+// Throughput and latency benchmarks for the octree backends.
+//
+// Every (workload, tree) pair is built from scratch several times. Each
+// result is printed as one JSON object per line, so runs can be diffed and
+// tracked for regressions.
+//
+// Every workload is inserted in both Morton and scan-line order, to measure
+// how sensitive set() is to insertion order. Trees whose max depth is below
+// --depth are skipped.
+//
+// Usage: octree_bench [--repetitions N] [--depth D] [--seed S] [--filter SUBSTRING]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "octree.h"
+#include "workloads.h"
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t BATCH_SIZE = 256;
+
+struct Options
+{
+    int repetitions = 5;
+    int depth = 8;
+    uint32_t seed = 1;
+    std::string filter;
+};
+
+double percentile(std::vector<double> values, double fraction)
+{
+    if (values.empty())
+    {
+        return 0;
+    }
+
+    std::sort(values.begin(), values.end());
+    const size_t index = std::min(values.size() - 1, (size_t)(fraction * values.size()));
+    return values[index];
+}
+
+struct PhaseResult
+{
+    std::vector<double> batch_ns_per_op; // Mean latency of each batch of operations
+    double total_seconds = 0;
+    size_t num_ops = 0;
+};
+
+void print_result(
+    const Workload& workload, WorkloadOrder order, const char* tree, const char* map,
+    const char* phase, const PhaseResult& result, size_t memory_bytes, int num_nodes
+)
+{
+    std::cout
+        << "{\"workload\": \"" << workload.name << "\""
+        << ", \"order\": \"" << to_string(order) << "\""
+        << ", \"tree\": \"" << tree << "\""
+        << ", \"map\": \"" << map << "\""
+        << ", \"depth\": " << (int)workload.depth
+        << ", \"phase\": \"" << phase << "\""
+        << ", \"ops\": " << result.num_ops
+        << ", \"mops_per_s\": " << (result.total_seconds > 0 ? result.num_ops / result.total_seconds / 1e6 : 0)
+        << ", \"p50_ns\": " << percentile(result.batch_ns_per_op, 0.5)
+        << ", \"p90_ns\": " << percentile(result.batch_ns_per_op, 0.9)
+        << ", \"p99_ns\": " << percentile(result.batch_ns_per_op, 0.99)
+        << ", \"memory_bytes\": " << memory_bytes
+        << ", \"nodes\": " << num_nodes
+        << "}" << std::endl;
+}
+
+// Runs function(i) for i in [0, count), timing batches of BATCH_SIZE calls
+template <typename Function>
+void time_batches(size_t count, PhaseResult& result, Function function)
+{
+    for (size_t begin = 0; begin < count; begin += BATCH_SIZE)
+    {
+        const size_t end = std::min(count, begin + BATCH_SIZE);
+        const auto start = Clock::now();
+
+        for (size_t i = begin; i < end; ++i)
+        {
+            function(i);
+        }
+
+        const double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        result.batch_ns_per_op.push_back(ns / (end - begin));
+        result.total_seconds += ns * 1e-9;
+        result.num_ops += end - begin;
+    }
+}
+
+template <typename Octree>
+void run(
+    const Workload& workload, WorkloadOrder order, const char* tree_name, const char* map_name,
+    const Options& options
+)
+{
+    using LocationCode = typename Octree::LocationCodeType;
+
+    if (workload.depth > Octree::get_max_depth())
+    {
+        return;
+    }
+
+    const std::vector<LocationCode> codes = workload_codes<typename Octree::LocationCodes>(workload, order);
+
+    PhaseResult build, lookup, volume, iterate;
+    size_t memory_bytes = 0;
+    int num_nodes = 0;
+    volatile float sink = 0;
+
+    for (int repetition = 0; repetition < options.repetitions; ++repetition)
+    {
+        Octree octree(false);
+        time_batches(codes.size(), build, [&](size_t i) { octree.set(codes[i]); });
+
+        size_t num_set = 0;
+        time_batches(codes.size(), lookup, [&](size_t i) { num_set += octree.is_set(codes[i]); });
+
+        time_batches(1, volume, [&](size_t) { sink = octree.get_volume(); });
+
+        // One batch per traversal, timed per region visited
+        size_t num_regions = 0;
+        const auto start = Clock::now();
+        octree.for_each_set([&](LocationCode, uint8_t) { ++num_regions; });
+        const double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        iterate.batch_ns_per_op.push_back(ns / std::max<size_t>(1, num_regions));
+        iterate.total_seconds += ns * 1e-9;
+        iterate.num_ops += num_regions;
+
+        memory_bytes = octree.memory_usage().get_total_bytes();
+        num_nodes = octree.get_num_nodes();
+        sink = sink + num_set;
+    }
+
+    print_result(workload, order, tree_name, map_name, "set", build, memory_bytes, num_nodes);
+    print_result(workload, order, tree_name, map_name, "is_set", lookup, memory_bytes, num_nodes);
+    print_result(workload, order, tree_name, map_name, "get_volume", volume, memory_bytes, num_nodes);
+    print_result(workload, order, tree_name, map_name, "for_each_set", iterate, memory_bytes, num_nodes);
+}
+
+Options parse_options(int argc, char** argv)
+{
+    Options options;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (std::strcmp(argv[i], "--repetitions") == 0)
+        {
+            options.repetitions = std::max(1, std::atoi(argv[i + 1]));
+        }
+        else if (std::strcmp(argv[i], "--depth") == 0)
+        {
+            options.depth = std::clamp(std::atoi(argv[i + 1]), 1, (int)LocationCodesBase<uint64_t>::max_depth());
+        }
+        else if (std::strcmp(argv[i], "--seed") == 0)
+        {
+            options.seed = (uint32_t)std::strtoul(argv[i + 1], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--filter") == 0)
+        {
+            options.filter = argv[i + 1];
+        }
+        else
+        {
+            std::cerr << "Unknown option " << argv[i] << std::endl;
+            std::exit(1);
+        }
+    }
+
+    return options;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const Options options = parse_options(argc, argv);
+
+    const uint8_t depth = options.depth;
+    const uint32_t seed = options.seed;
+
+    // Generated on demand, since dense workloads at large depths only fit in
+    // memory one at a time, and not at all unless selected by --filter
+    const std::vector<std::pair<std::string, std::function<Workload()>>> workloads = {
+        {"full_grid", [=] { return full_grid_workload(depth); }},
+        {"sphere", [=] { return sphere_workload(depth); }},
+        {"primitives", [=] { return primitives_workload(depth, seed); }},
+        {"random_sparse", [=] { return random_sparse_workload(depth, seed); }},
+        {"planar_surfaces", [=] { return planar_surfaces_workload(depth); }},
+        {"clustered", [=] { return clustered_workload(depth, seed); }},
+        {"terrain", [=] { return terrain_workload(depth, seed); }},
+        {"lidar", [=] { return lidar_workload(depth, seed); }},
+        {"random_walk", [=] { return random_walk_workload(depth, seed); }},
+    };
+
+    for (const auto& [name, generate] : workloads)
+    {
+        if (!options.filter.empty() && name.find(options.filter) == std::string::npos)
+        {
+            continue;
+        }
+
+        const Workload workload = generate();
+
+        for (WorkloadOrder order : {WorkloadOrder::MORTON, WorkloadOrder::SCANLINE})
+        {
+            run<Octree32>(workload, order, "Octree32", "UnorderedMapWrapper", options);
+            run<PooledOctree32>(workload, order, "Octree32", "PooledUnorderedMapWrapper", options);
+            run<Octree64>(workload, order, "Octree64", "UnorderedMapWrapper", options);
+            run<PooledOctree64>(workload, order, "Octree64", "PooledUnorderedMapWrapper", options);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,72 @@
+#ifndef _OCTREE_STATS_H_
+#define _OCTREE_STATS_H_
+
+#include <array>
+#include <cstdint>
+#include <iostream>
+
+#include "location_code.h"
+
+// Hot-path counters are compiled in only when OCTREE_ENABLE_STATS is defined;
+// otherwise OCTREE_STAT() expands to nothing and trees carry no counters. The
+// macro changes the layout of OctreeBase and the bodies of its inline
+// functions, so every translation unit in a binary must agree on it. The
+// counters are plain integers bumped from const queries too, so queries on a
+// shared tree are not thread-safe while stats are enabled.
+#ifdef OCTREE_ENABLE_STATS
+#define OCTREE_STAT(statement) statement
+#else
+#define OCTREE_STAT(statement)
+#endif
+
+struct OctreeStats
+{
+    static constexpr size_t NUM_DEPTHS = 21; // Enough for Octree64
+    static constexpr size_t NUM_ERASE_BUCKETS = 64;
+
+    std::array<uint64_t, NUM_DEPTHS> probes{};         // Hash lookups, by node depth
+    std::array<uint64_t, NUM_DEPTHS> emplace_hits{};   // set() found the node, by depth
+    std::array<uint64_t, NUM_DEPTHS> emplace_misses{}; // set() created the node, by depth
+    uint64_t ancestor_set_returns = 0;                 // set() stopped at a set ancestor
+    uint64_t collapse_steps = 0;                       // Full nodes merged into their parent
+    // erase_node() calls, bucketed by floor(log2(nodes erased + 1))
+    std::array<uint64_t, NUM_ERASE_BUCKETS> erase_sizes{};
+
+    void record_probe(int depth) { ++probes[depth]; }
+
+    void record_emplace(int depth, bool inserted)
+    {
+        ++(inserted ? emplace_misses : emplace_hits)[depth];
+    }
+
+    void record_erase(uint64_t num_erased)
+    {
+        ++erase_sizes[LocationCodesBase<uint64_t>::high_bit_index(num_erased + 1)];
+    }
+
+    void reset() { *this = OctreeStats(); }
+
+    // One "name value" line per non-zero counter
+    void dump(std::ostream& os) const
+    {
+        const auto dump_array = [&os](const char* name, const auto& values)
+        {
+            for (size_t i = 0; i < values.size(); ++i)
+            {
+                if (values[i] != 0)
+                {
+                    os << name << '[' << i << "] " << values[i] << '\n';
+                }
+            }
+        };
+
+        dump_array("probes", probes);
+        dump_array("emplace_hits", emplace_hits);
+        dump_array("emplace_misses", emplace_misses);
+        os << "ancestor_set_returns " << ancestor_set_returns << '\n';
+        os << "collapse_steps " << collapse_steps << '\n';
+        dump_array("erase_sizes_log2", erase_sizes);
+    }
+};
+
+#endif // _OCTREE_STATS_H_
@@ -1,9 +1,21 @@
-#include <chrono>
+#include <algorithm>
+#include <cstring>
 #include <immintrin.h>
 #include <iostream>
+#include <random>
+#include <sstream>
 #include <vector>
 
+#include "attribute_octree.h"
+#include "brick_octree.h"
+#include "distance_field.h"
+#include "mesh_voxelizer.h"
+#include "occupancy_octree.h"
 #include "octree.h"
+#include "payload_tree.h"
+#include "pointer_octree.h"
+#include "sparse_voxel_dag.h"
+#include "workloads.h"
 #include "catch.hpp"
 
 NodeType make_node(const std::vector<int>& children_set, const std::vector<int>& children_exist)
@@ -32,27 +44,6 @@ uint32_t make_locator(int depth, int x_index, int y_index, int z_index)
     );
 };
 
-class Timer
-{
-public:
-
-    Timer(const char* name) : 
-        _name(name),
-        _start_time(std::chrono::high_resolution_clock::now())
-    {}
-
-    ~Timer()
-    {
-        const auto duration = (std::chrono::high_resolution_clock::now() - _start_time).count();
-        std::cout << _name << " took " << duration << " ns" << std::endl;
-    }
-
-private:
-    
-    const char* _name;
-    const std::chrono::time_point<std::chrono::high_resolution_clock> _start_time;
-};
-
 /////////////////////////////////////////////////////
 
 TEST_CASE("Empty octree")
@@ -200,55 +191,39 @@ TEST_CASE("Basic set unwinding")
 
 TEST_CASE("Sphere test")
 {
-    constexpr int depth = 7;
+    constexpr int depth = 6;
     constexpr int res = 1 << depth;
 
     // Make a res^3 octree representing a sphere
     Octree32 octree(false);
-    octree.reserve(1 << (3 * depth));
-    //octree.reserve(100000);
 
     std::vector<float> centers;
     for (int i = 0; i < res; ++i)
     {
         centers.push_back((float)i / res + 0.5f/res - 0.5f);
-        //std::cout << i << ": " << centers.back() << std::endl;
     }
 
+    int num_inside = 0;
+    for (int x_index = 0; x_index < res; ++x_index)
     {
-        Timer timer("Building octree");
-
-        for (int x_index = 0; x_index < res; ++x_index)
+        for (int y_index = 0; y_index < res; ++y_index)
         {
-            for (int y_index = 0; y_index < res; ++y_index)
-            {;
-                for (int z_index = 0; z_index < res; ++z_index)
-                {
-                    // if (centers[x_index]*centers[x_index] + centers[y_index]*centers[y_index] + centers[z_index]*centers[z_index] >= 0.25f)
-                    //     continue;
-
-                    if (x_index != res - 1 || y_index != res - 1 || z_index != res - 1)
+            for (int z_index = 0; z_index < res; ++z_index)
+            {
+                if (centers[x_index]*centers[x_index] + centers[y_index]*centers[y_index] + centers[z_index]*centers[z_index] >= 0.25f)
+                    continue;
 
-                        octree.set(make_locator(depth, x_index, y_index, z_index));
-                }
+                octree.set(make_locator(depth, x_index, y_index, z_index));
+                ++num_inside;
             }
         }
     }
 
-    float volume;
-    {
-        Timer timer("Getting volume");
-        volume = octree.get_volume();
-    }
-    std::cout << "volume = " << volume << std::endl;
+    REQUIRE(octree.get_volume() == Approx((double)num_inside / (1 << 3 * depth)));
+    REQUIRE(octree.get_volume() == Approx(3.14159265 / 6).epsilon(0.01));
 
-    uint32_t num_nodes;
-    {
-        Timer timer("Getting num nodes");
-        num_nodes = octree.get_num_nodes();
-    }
-    std::cout << "Num nodes = " << num_nodes << std::endl;
-    //std::cout << octree.get_node_map() << std::endl;
+    // The sphere's interior collapses into large nodes
+    REQUIRE(octree.get_num_nodes() < num_inside / 4);
 }
 
 TEST_CASE("Bit hacks")
@@ -275,4 +250,1301 @@ TEST_CASE("Bit hacks")
             512*(13.0f/16.0f), 512*(2.0f/16.0f), 512*(6.0f/16.0f)
         )
     );
-}
\ No newline at end of file
+}
+
+TEST_CASE("Location code encoding")
+{
+    using LC = LocationCodesBase<uint32_t>;
+
+    REQUIRE(LC::encode(0, 0, 0, 0) == 0b1);
+    REQUIRE(LC::encode(1, 1, 1, 0) == 0b1011);
+    REQUIRE(LC::encode(4, 13, 2, 6) == 0b1001101110001);
+    REQUIRE(LC::cell_index(0b1001101110001) == GridPoint{13, 2, 6});
+    REQUIRE(LC::lower_corner_point(0b1111010) == GridPoint{256, 256+128, 256});
+    REQUIRE(LC::cell_size(0) == 512);
+    REQUIRE(LC::cell_size(9) == 1);
+
+    using LC64 = LocationCodesBase<uint64_t>;
+    const uint64_t deep = LC64::encode(20, 123456, 654321, 1);
+    REQUIRE(LC64::depth(deep) == 20);
+    REQUIRE(LC64::cell_index(deep) == GridPoint{123456, 654321, 1});
+}
+
+TEST_CASE("Box query")
+{
+    Octree32 octree(false);
+    octree.set(0b1000);
+    octree.set(0b1111000111);
+
+    const std::vector<uint32_t> in_corner = octree.query_box({0, 0, 0}, {10, 10, 10});
+    REQUIRE(in_corner == std::vector<uint32_t>{0b1000});
+
+    std::vector<uint32_t> everything = octree.query_box({0, 0, 0}, {512, 512, 512});
+    std::sort(everything.begin(), everything.end());
+    REQUIRE(everything == std::vector<uint32_t>{0b1000, 0b1111000111});
+
+    REQUIRE(octree.query_box({300, 0, 0}, {512, 200, 512}).empty());
+
+    REQUIRE(octree.volume_in_box({0, 0, 0}, {512, 512, 512}) == octree.get_volume());
+    REQUIRE(octree.volume_in_box({128, 0, 0}, {384, 256, 256}) == 1.0f / 16);
+    REQUIRE(octree.volume_in_box({300, 0, 0}, {512, 200, 512}) == 0);
+}
+
+TEST_CASE("Nearest set region")
+{
+    using LC = LocationCodesBase<uint32_t>;
+    const uint32_t cell = LC::encode(9, 328, 328, 328);
+
+    Octree32 octree(false);
+    REQUIRE(!octree.nearest_set(Vertex(0, 0, 0), 1000).has_value());
+
+    octree.set(0b1000);                // [0, 256)^3
+    octree.set(cell);
+
+    const auto inside = octree.nearest_set(Vertex(10, 20, 30), 1000);
+    REQUIRE(inside.has_value());
+    REQUIRE(inside->location_code == 0b1000);
+    REQUIRE(inside->distance == 0);
+
+    const auto near_cell = octree.nearest_set(Vertex(330, 328.5f, 328.5f), 1000);
+    REQUIRE(near_cell.has_value());
+    REQUIRE(near_cell->location_code == cell);
+    REQUIRE(near_cell->distance == 1);
+
+    const auto near_big = octree.nearest_set(Vertex(260, 100, 100), 1000);
+    REQUIRE(near_big.has_value());
+    REQUIRE(near_big->location_code == 0b1000);
+    REQUIRE(near_big->distance == 4);
+
+    REQUIRE(!octree.nearest_set(Vertex(500, 500, 500), 100).has_value());
+}
+
+TEST_CASE("Distance field")
+{
+    using LC = LocationCodesBase<uint32_t>;
+
+    Octree32 octree(false);
+    octree.set(LC::encode(5, 10, 10, 10));
+    octree.set(LC::encode(9, 400, 400, 400)); // Marks its whole depth 5 cell
+
+    const DistanceField<Octree32> field(octree, 5);
+    REQUIRE(field.get_resolution() == 32);
+    REQUIRE(field.get(10, 10, 10) == 0);
+    REQUIRE(field.get(25, 25, 25) == 0);
+    REQUIRE(field.get(13, 10, 10) == 3 * 16);
+    REQUIRE(field.get(13, 14, 10) == 5 * 16);
+    REQUIRE(field.get(0, 0, 0) == Approx(std::sqrt(300.0f) * 16));
+
+    const Vertex gradient = field.gradient(Vertex(13.5f * 16, 10.5f * 16, 10.5f * 16));
+    REQUIRE(gradient.x == Approx(1));
+    REQUIRE(gradient.y == Approx(0));
+    REQUIRE(gradient.z == Approx(0));
+
+    Octree32 block(false);
+    block.set(LC::encode(3, 1, 1, 1)); // Grid cells [4, 8)^3 at depth 5
+
+    const DistanceField<Octree32> signed_field(block, 5, true);
+    REQUIRE(signed_field.get(5, 5, 5) == -2 * 16);
+    REQUIRE(signed_field.get(4, 5, 5) == -1 * 16);
+    REQUIRE(signed_field.get(3, 5, 5) == 1 * 16);
+    REQUIRE(signed_field.sample(Vertex(4 * 16, 5.5f * 16, 5.5f * 16)) == 0);
+}
+
+TEST_CASE("Set region iteration")
+{
+    Octree32 octree(false);
+    octree.set(0b1111000111);
+    octree.set(0b1000);
+    octree.set(0b1001010);
+    octree.set(0b1001011);
+
+    std::vector<uint32_t> codes;
+    std::vector<int> depths;
+    for (const SetRegion<uint32_t>& region : octree.set_regions())
+    {
+        codes.push_back(region.location_code);
+        depths.push_back(region.depth);
+    }
+
+    REQUIRE(codes == std::vector<uint32_t>{0b1000, 0b1001010, 0b1001011, 0b1111000111});
+    REQUIRE(depths == std::vector<int>{1, 2, 2, 3});
+
+    size_t count = 0;
+    octree.for_each_set([&](uint32_t location_code, uint8_t depth)
+    {
+        REQUIRE(location_code == codes[count]);
+        ++count;
+    });
+    REQUIRE(count == codes.size());
+
+    Octree32 empty(false);
+    REQUIRE(empty.set_regions().begin() == empty.set_regions().end());
+}
+
+TEST_CASE("Visitor traversal")
+{
+    using LC64 = LocationCodesBase<uint64_t>;
+
+    Octree64 octree(false);
+    const uint64_t deepest = LC64::encode(20, 1, 2, 3);
+    octree.set(deepest);
+    octree.set(0b1111);
+
+    struct Counter : OctreeVisitor<uint64_t>
+    {
+        void enter_node(uint64_t location_code, NodeType node) { ++entered; }
+        void set_child(uint64_t location_code) { set_codes.push_back(location_code); }
+        void exit_node(uint64_t location_code, NodeType node) { ++exited; }
+
+        int entered = 0;
+        int exited = 0;
+        std::vector<uint64_t> set_codes;
+    } counter;
+
+    octree.traverse(counter);
+    REQUIRE(counter.entered == 20);
+    REQUIRE(counter.exited == 20);
+    REQUIRE(counter.set_codes == std::vector<uint64_t>{deepest, 0b1111});
+    REQUIRE(octree.get_volume() == Approx(1.0f / 8 + 1.0f / (1ull << 60)));
+
+    struct Pruner : OctreeVisitor<uint64_t>
+    {
+        void enter_node(uint64_t location_code, NodeType node) { ++entered; }
+        bool prune(uint64_t location_code) { return LC64::depth(location_code) >= 2; }
+
+        int entered = 0;
+    } pruner;
+
+    octree.traverse(pruner);
+    REQUIRE(pruner.entered == 2);
+
+    // Setting an ancestor erases the whole 20 level chain below it
+    octree.set(0b1000);
+    REQUIRE(octree.get_num_nodes() == 2);
+    REQUIRE(octree.get_volume() == 0.25f);
+}
+
+TEST_CASE("Clear")
+{
+    using LC = LocationCodesBase<uint32_t>;
+
+    Octree32 octree(true);
+    const uint32_t cell = LC::encode(9, 5, 6, 7);
+    octree.clear(cell);
+
+    REQUIRE(!octree.is_set(cell));
+    REQUIRE(octree.is_set(LC::encode(9, 5, 6, 6)));
+    REQUIRE(!octree.is_set(1));
+    REQUIRE(octree.get_num_nodes() == 10);
+    REQUIRE(octree.get_volume() == Approx(1 - 1.0 / (1 << 27)));
+
+    // Clearing an already empty region changes nothing
+    octree.clear(cell);
+    REQUIRE(octree.get_num_nodes() == 10);
+
+    // Setting it again collapses back to a full root
+    octree.set(cell);
+    REQUIRE(octree.is_set(1));
+    REQUIRE(octree.get_num_nodes() == 2);
+
+    // Clearing the last set descendants of a node removes the empty chain
+    Octree32 sparse(false);
+    sparse.set(0b1111000111);
+    sparse.set(0b1001);
+    sparse.clear(0b1111000111);
+
+    const Octree32::NodeMapType expected = {
+        {0b1, make_node({1}, {})},
+    };
+    REQUIRE(sparse.get_node_map() == expected);
+
+    sparse.clear(0b1);
+    REQUIRE(sparse.get_volume() == 0);
+}
+
+TEST_CASE("Brick octree")
+{
+    using LC = LocationCodesBase<uint32_t>;
+
+    BrickOctree32 octree(false);
+    for (uint32_t i = 0; i < 64; ++i)
+    {
+        octree.set(LC::encode(9, 4 + (i & 3), 8 + ((i >> 2) & 3), 12 + (i >> 4)));
+        if (i < 63)
+        {
+            REQUIRE(octree.get_brick_map().size() == 1);
+        }
+    }
+
+    // A full brick collapses into its coarse node
+    REQUIRE(octree.get_brick_map().empty());
+    REQUIRE(octree.is_set(LC::encode(7, 1, 2, 3)));
+    REQUIRE(octree.get_volume() == 1.0f / (1 << 21));
+
+    // Splitting it again recreates the brick
+    octree.clear(LC::encode(8, 2, 4, 6));
+    REQUIRE(octree.get_brick_map().size() == 1);
+    REQUIRE(octree.get_volume() == 56.0f / (1 << 27));
+    REQUIRE(!octree.is_set(LC::encode(9, 4, 8, 12)));
+    REQUIRE(octree.is_set(LC::encode(9, 6, 8, 12)));
+}
+
+TEST_CASE("Brick octree matches Octree32")
+{
+    using LC = LocationCodesBase<uint32_t>;
+
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<uint32_t> coord(0, 63);
+    std::uniform_int_distribution<int> action(0, 19);
+
+    Octree32 reference(false);
+    BrickOctree32 bricked(false);
+
+    for (int step = 0; step < 20000; ++step)
+    {
+        // Mostly max-depth cells, with some coarser regions and clears
+        const int kind = action(rng);
+        const int shift = (kind == 1) ? 3 : (kind < 4) ? 1 : 0;
+        const uint32_t location_code = LC::encode(9 - shift, coord(rng) >> shift, coord(rng) >> shift, coord(rng) >> shift);
+
+        if (kind < 3)
+        {
+            reference.clear(location_code);
+            bricked.clear(location_code);
+        }
+        else
+        {
+            reference.set(location_code);
+            bricked.set(location_code);
+        }
+    }
+
+    std::vector<uint32_t> expected, actual;
+    reference.for_each_set([&](uint32_t location_code, uint8_t) { expected.push_back(location_code); });
+    bricked.for_each_set([&](uint32_t location_code, uint8_t) { actual.push_back(location_code); });
+
+    REQUIRE(!expected.empty());
+    REQUIRE(actual == expected);
+    REQUIRE(bricked.get_volume() == Approx(reference.get_volume()));
+    REQUIRE(bricked.get_num_nodes() < reference.get_num_nodes());
+}
+
+TEST_CASE("Raycast")
+{
+    using LC = LocationCodesBase<uint32_t>;
+
+    Octree32 octree(false);
+    octree.set(LC::encode(9, 100, 10, 10));
+    octree.set(LC::encode(2, 3, 0, 0)); // x in [384, 512)
+
+    const auto hit = octree.raycast(Vertex(0.5f, 10.5f, 10.5f), Vertex(1, 0, 0), 1000);
+    REQUIRE(hit.has_value());
+    REQUIRE(*hit == Approx(99.5f));
+
+    const auto far_hit = octree.raycast(Vertex(0.5f, 20.5f, 10.5f), Vertex(2, 0, 0), 1000);
+    REQUIRE(far_hit.has_value());
+    REQUIRE(*far_hit == Approx(383.5f));
+
+    REQUIRE(!octree.raycast(Vertex(0.5f, 20.5f, 10.5f), Vertex(1, 0, 0), 300).has_value());
+    REQUIRE(!octree.raycast(Vertex(0.5f, 20.5f, 10.5f), Vertex(-1, 0, 0), 1000).has_value());
+
+    const auto backwards = octree.raycast(Vertex(500, 10.5f, 10.5f), Vertex(-1, 0, 0), 1000);
+    REQUIRE(backwards.has_value());
+    REQUIRE(*backwards == 0);
+}
+
+TEST_CASE("Sparse voxel DAG")
+{
+    using LC = LocationCodesBase<uint32_t>;
+
+    // The same shelf pattern repeated in every octant
+    Octree32 octree(false);
+    for (uint32_t octant = 0; octant < 8; ++octant)
+    {
+        const uint32_t base_x = (octant & 1) * 32, base_y = ((octant >> 1) & 1) * 32, base_z = (octant >> 2) * 32;
+        for (uint32_t x = 0; x < 32; x += 3)
+        {
+            for (uint32_t z = 0; z < 32; ++z)
+            {
+                octree.set(LC::encode(6, base_x + x, base_y + 5, base_z + z));
+            }
+        }
+    }
+
+    const SparseVoxelDag<uint32_t> dag = freeze(octree);
+    REQUIRE(dag.get_num_nodes() * 8 < (size_t)octree.get_num_nodes());
+    REQUIRE(dag.get_volume() == octree.get_volume());
+
+    for (uint32_t location_code : {LC::encode(6, 3, 5, 7), LC::encode(6, 4, 5, 7), LC::encode(6, 35, 37, 40), LC::encode(5, 0, 2, 0), 1u})
+    {
+        REQUIRE(dag.is_set(location_code) == octree.is_set(location_code));
+    }
+
+    const Vertex origin(9, 44.5f, 100.5f);
+    const Vertex direction(1, 0.01f, 0.02f);
+    REQUIRE(octree.raycast(origin, direction, 1000).value() == Approx(15).epsilon(0.01));
+    REQUIRE(dag.raycast(origin, direction, 1000) == octree.raycast(origin, direction, 1000));
+
+    std::stringstream stream;
+    dag.write(stream);
+    const SparseVoxelDag<uint32_t> loaded(stream);
+    REQUIRE(loaded.get_num_nodes() == dag.get_num_nodes());
+    REQUIRE(loaded.get_volume() == dag.get_volume());
+
+    // Corrupt root, size and node words are rejected up front
+    const std::string bytes = stream.str();
+    const auto load_corrupted = [&](size_t position, uint64_t value, size_t length)
+    {
+        std::string copy = bytes;
+        std::memcpy(&copy[position], &value, length);
+        std::stringstream corrupted(copy);
+        SparseVoxelDag<uint32_t> result(corrupted);
+    };
+
+    REQUIRE_THROWS(load_corrupted(8, dag.get_num_bytes() / 4, 8));
+    REQUIRE_THROWS(load_corrupted(24, uint64_t(1) << 40, 8));
+    REQUIRE_THROWS(load_corrupted(32 + 4, 1000000, 4));
+
+    std::stringstream truncated(bytes.substr(0, bytes.size() - 4));
+    REQUIRE_THROWS(SparseVoxelDag<uint32_t>(truncated));
+}
+
+TEST_CASE("Pointer octree matches Octree32")
+{
+    using LC = LocationCodesBase<uint32_t>;
+
+    std::mt19937 rng(99);
+    std::uniform_int_distribution<uint32_t> coord(0, 63);
+    std::uniform_int_distribution<int> action(0, 19);
+
+    Octree32 reference(false);
+    PointerOctree32 pointer(false);
+
+    for (int step = 0; step < 20000; ++step)
+    {
+        const int kind = action(rng);
+        const int shift = (kind == 1) ? 3 : (kind < 4) ? 1 : 0;
+        const uint32_t location_code = LC::encode(9 - shift, coord(rng) >> shift, coord(rng) >> shift, coord(rng) >> shift);
+
+        if (kind < 3)
+        {
+            reference.clear(location_code);
+            pointer.clear(location_code);
+        }
+        else
+        {
+            reference.set(location_code);
+            pointer.set(location_code);
+        }
+    }
+
+    std::vector<uint32_t> expected, actual;
+    reference.for_each_set([&](uint32_t location_code, uint8_t) { expected.push_back(location_code); });
+    pointer.for_each_set([&](uint32_t location_code, uint8_t) { actual.push_back(location_code); });
+
+    REQUIRE(actual == expected);
+    REQUIRE(pointer.get_num_nodes() == reference.get_num_nodes());
+    REQUIRE(pointer.get_volume() == reference.get_volume());
+    REQUIRE(pointer.get_node(LC::encode(5, 1, 2, 3)) == reference.get_node(LC::encode(5, 1, 2, 3)));
+
+    // Conversions in both directions reproduce the same nodes
+    const PointerOctree32 converted(reference);
+    REQUIRE(converted.get_num_nodes() == reference.get_num_nodes());
+    REQUIRE(converted.to_octree<UnorderedMapWrapper>().get_node_map() == reference.get_node_map());
+    REQUIRE(pointer.to_octree<UnorderedMapWrapper>().get_node_map() == reference.get_node_map());
+
+    const Vertex origin(0.5f, 20.5f, 30.5f);
+    const Vertex direction(1, 0.5f, 0.25f);
+    REQUIRE(reference.raycast(origin, direction, 1000).has_value());
+    REQUIRE(pointer.raycast(origin, direction, 1000) == reference.raycast(origin, direction, 1000));
+}
+
+TEST_CASE("Pooled node allocation")
+{
+    using LC = LocationCodesBase<uint32_t>;
+
+    PooledOctree32 pooled(false);
+    Octree32 reference(false);
+    const NodePoolResource& pool = pooled.get_node_map().get_allocator().get_resource();
+
+    size_t num_chunks = 0;
+    for (int cycle = 0; cycle < 3; ++cycle)
+    {
+        for (uint32_t i = 0; i < 5000; ++i)
+        {
+            const uint32_t location_code = LC::encode(9, (i * 7) % 97, (i * 13) % 89, (i * 31) % 83);
+            pooled.set(location_code);
+            reference.set(location_code);
+        }
+
+        REQUIRE(pooled.get_num_nodes() == reference.get_num_nodes());
+        REQUIRE(pooled.get_volume() == reference.get_volume());
+        REQUIRE(pool.get_num_live() == pooled.get_node_map().size());
+
+        // Later cycles reuse the chunks of the first
+        if (cycle == 0)
+        {
+            num_chunks = pool.get_num_chunks();
+        }
+        REQUIRE(pool.get_num_chunks() == num_chunks);
+
+        pooled.clear_root();
+        reference.clear_root();
+        REQUIRE(pool.get_num_live() == 1);
+    }
+
+    // Copies get their own pool
+    pooled.set(0b1000);
+    const PooledOctree32 copy = pooled;
+    REQUIRE(copy.get_node_map() == pooled.get_node_map());
+    REQUIRE(&copy.get_node_map().get_allocator().get_resource() != &pool);
+}
+
+TEST_CASE("Memory usage")
+{
+    Octree32 octree(false);
+    octree.set(0b1000111000111101010111);
+    octree.set(0b1000111111111101010111);
+
+    const MemoryUsage usage = octree.memory_usage();
+    REQUIRE(usage.num_nodes == octree.get_node_map().size());
+    REQUIRE(usage.nodes_per_depth == std::vector<size_t>{1, 1, 1, 2, 2, 2, 2, 0, 0});
+    REQUIRE(usage.node_bytes == usage.num_nodes * (sizeof(void*) + sizeof(std::pair<const uint32_t, NodeType>)));
+    REQUIRE(usage.num_buckets == octree.get_node_map().bucket_count());
+    REQUIRE(usage.bucket_bytes + usage.wasted_bytes == usage.num_buckets * sizeof(void*));
+    REQUIRE(usage.get_load_factor() == octree.get_node_map().load_factor());
+
+    PooledOctree32 pooled(false);
+    pooled.set(0b1000111000111101010111);
+
+    const MemoryUsage pooled_usage = pooled.memory_usage();
+    REQUIRE(pooled_usage.get_total_bytes() >= NodePoolResource::CHUNK_SIZE);
+    REQUIRE(pooled_usage.nodes_per_depth[6] == 1);
+
+    // The brick and its anchoring coarse node
+    BrickOctree32 bricked(false);
+    bricked.set(LocationCodesBase<uint32_t>::encode(9, 1, 2, 3));
+    REQUIRE(bricked.memory_usage().nodes_per_depth[7] == 2);
+    REQUIRE(bricked.memory_usage().num_nodes == 9);
+}
+
+TEST_CASE("Workload generators")
+{
+    using LC = LocationCodesBase<uint32_t>;
+
+    REQUIRE(lidar_workload(6, 3).cells == lidar_workload(6, 3).cells);
+    REQUIRE(terrain_workload(6, 3).cells == terrain_workload(6, 3).cells);
+    REQUIRE(random_walk_workload(6, 3).cells != random_walk_workload(6, 4).cells);
+
+    for (const Workload& workload : {primitives_workload(5, 1), terrain_workload(5, 1), lidar_workload(5, 1), random_walk_workload(5, 1)})
+    {
+        REQUIRE(!workload.cells.empty());
+
+        const std::vector<uint32_t> morton = workload_codes<LC>(workload, WorkloadOrder::MORTON);
+        const std::vector<uint32_t> scanline = workload_codes<LC>(workload, WorkloadOrder::SCANLINE);
+        REQUIRE(std::is_sorted(morton.begin(), morton.end()));
+        REQUIRE(std::is_permutation(morton.begin(), morton.end(), scanline.begin()));
+
+        // Insertion order must not change the resulting tree
+        Octree32 morton_octree(false), scanline_octree(false);
+        for (size_t i = 0; i < morton.size(); ++i)
+        {
+            morton_octree.set(morton[i]);
+            scanline_octree.set(scanline[i]);
+        }
+        REQUIRE(morton_octree.get_node_map() == scanline_octree.get_node_map());
+    }
+
+    Octree32 full(false);
+    for (uint32_t location_code : workload_codes<LC>(full_grid_workload(3), WorkloadOrder::SCANLINE))
+    {
+        full.set(location_code);
+    }
+    REQUIRE(full.get_volume() == 1.0f);
+    REQUIRE(full.get_num_nodes() == 2);
+}
+
+TEST_CASE("Set from SDF")
+{
+    using LC = LocationCodesBase<uint32_t>;
+
+    // A sphere filling the root, sampled at depth 6 cell centres
+    size_t num_evaluations = 0;
+    const auto sphere = [&num_evaluations](const Vertex& v)
+    {
+        ++num_evaluations;
+        return std::sqrt((v.x - 256) * (v.x - 256) + (v.y - 256) * (v.y - 256) + (v.z - 256) * (v.z - 256)) - 256;
+    };
+
+    Octree32 hierarchical(false);
+    hierarchical.set_sdf(sphere, 6);
+    REQUIRE(num_evaluations < (1 << 18) / 4);
+
+    Octree32 brute_force(false);
+    for (uint32_t x = 0; x < 64; ++x)
+    {
+        for (uint32_t y = 0; y < 64; ++y)
+        {
+            for (uint32_t z = 0; z < 64; ++z)
+            {
+                if (sphere(Vertex(x * 8 + 4, y * 8 + 4, z * 8 + 4)) < 0)
+                {
+                    brute_force.set(LC::encode(6, x, y, z));
+                }
+            }
+        }
+    }
+    REQUIRE(hierarchical.get_node_map() == brute_force.get_node_map());
+
+    // Whole-tree shapes collapse to the root, and set_sdf adds to what is there
+    Octree32 octree(false);
+    octree.set(0b1001); // x in the upper half
+    octree.set_sdf([](const Vertex& v) { return v.x - 256; }, 9);
+    REQUIRE(octree.get_volume() == 0.5f + 0.125f);
+    REQUIRE(octree.get_num_nodes() == 2);
+
+    octree.set_sdf([](const Vertex&) { return -1.0f; }, 3);
+    REQUIRE(octree.get_node_map().at(1) == ALL_CHILDREN_SET);
+}
+
+// Two triangles per face of an axis-aligned box, wound outwards
+std::vector<Triangle> box_mesh(float low, float high)
+{
+    std::vector<Triangle> triangles;
+    const float c[2] = {low, high};
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        for (int side = 0; side < 2; ++side)
+        {
+            const auto corner = [&](int u, int v)
+            {
+                float p[3];
+                p[axis] = c[side];
+                p[(axis + 1) % 3] = c[u];
+                p[(axis + 2) % 3] = c[v];
+                return Vertex(p[0], p[1], p[2]);
+            };
+
+            if (side == 1)
+            {
+                triangles.push_back({corner(0, 0), corner(1, 0), corner(1, 1)});
+                triangles.push_back({corner(0, 0), corner(1, 1), corner(0, 1)});
+            }
+            else
+            {
+                triangles.push_back({corner(0, 0), corner(1, 1), corner(1, 0)});
+                triangles.push_back({corner(0, 0), corner(0, 1), corner(1, 1)});
+            }
+        }
+    }
+
+    return triangles;
+}
+
+TEST_CASE("Mesh voxelization")
+{
+    using LC = LocationCodesBase<uint32_t>;
+
+    // Faces at 70 and 186 lie inside the depth 5 cells 4 and 11, and the face
+    // diagonals pass exactly through column centres.
+    const std::vector<Triangle> box = box_mesh(70, 186);
+    const float cell_volume = 1.0f / (32 * 32 * 32);
+
+    Octree32 surface(false);
+    voxelize_mesh(surface, box, 5);
+    REQUIRE(surface.get_volume() == Approx((8 * 8 * 8 - 6 * 6 * 6) * cell_volume));
+    REQUIRE(surface.is_set(LC::encode(5, 4, 7, 9)));
+    REQUIRE(!surface.is_set(LC::encode(5, 5, 7, 9)));
+
+    Octree32 solid(false);
+    voxelize_mesh(solid, box, 5, VoxelizeMode::SOLID);
+    REQUIRE(solid.get_volume() == Approx(8 * 8 * 8 * cell_volume));
+    REQUIRE(solid.is_set(LC::encode(5, 5, 7, 9)));
+
+    // Hierarchical descent finds the same cells as testing every cell
+    const std::vector<Triangle> tilted = {{Vertex(13, 400, 77), Vertex(310, 20, 250), Vertex(480, 470, 10)}};
+    Octree32 hierarchical(false), brute_force(false);
+    voxelize_mesh(hierarchical, tilted, 6);
+
+    const mesh_voxelizer_detail::Vec3 triangle[3] = {{13, 400, 77}, {310, 20, 250}, {480, 470, 10}};
+    for (uint32_t x = 0; x < 64; ++x)
+    {
+        for (uint32_t y = 0; y < 64; ++y)
+        {
+            for (uint32_t z = 0; z < 64; ++z)
+            {
+                if (mesh_voxelizer_detail::triangle_box_overlap(triangle, {x * 8 + 4.0f, y * 8 + 4.0f, z * 8 + 4.0f}, 4))
+                {
+                    brute_force.set(LC::encode(6, x, y, z));
+                }
+            }
+        }
+    }
+    REQUIRE(brute_force.get_volume() > 0);
+    REQUIRE(hierarchical.get_node_map() == brute_force.get_node_map());
+}
+
+TEST_CASE("Point insertion")
+{
+    using LC = LocationCodesBase<uint64_t>;
+
+    const BoundingBox bounds{Vertex(-10, -10, 0), Vertex(10, 10, 5)};
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> coord(-12, 12);
+
+    std::vector<float> points;
+    for (int i = 0; i < 20000; ++i)
+    {
+        points.insert(points.end(), {coord(rng), coord(rng), coord(rng) * 0.25f + 2.5f});
+    }
+    points.insert(points.end(), {NAN, 0, 1, 10, 0, 1, -10, -10, 0});
+
+    Octree64 bulk(false);
+    bulk.insert_points(points.data(), points.size() / 3, bounds, 7);
+
+    Octree64 reference(false);
+    for (size_t i = 0; i < points.size(); i += 3)
+    {
+        const float x = (points[i] + 10) / 20 * 128, y = (points[i + 1] + 10) / 20 * 128, z = points[i + 2] / 5 * 128;
+        if (x >= 0 && x < 128 && y >= 0 && y < 128 && z >= 0 && z < 128)
+        {
+            reference.set(LC::encode(7, x, y, z));
+        }
+    }
+    REQUIRE(reference.is_set(LC::encode(7, 0, 0, 0)));
+    REQUIRE(bulk.get_node_map() == reference.get_node_map());
+
+    // One point per cell fills the root through merged octets
+    std::vector<float> grid;
+    for (int z = 0; z < 4; ++z)
+    {
+        for (int y = 0; y < 4; ++y)
+        {
+            for (int x = 0; x < 4; ++x)
+            {
+                grid.insert(grid.end(), {x + 0.5f, y + 0.5f, z + 0.5f});
+            }
+        }
+    }
+
+    Octree64 full(false);
+    full.insert_points(grid.data(), grid.size() / 3, BoundingBox{Vertex(0, 0, 0), Vertex(4, 4, 4)}, 2);
+    REQUIRE(full.get_num_nodes() == 2);
+    REQUIRE(full.get_volume() == 1.0f);
+}
+
+TEST_CASE("Neighbor codes")
+{
+    using LC = LocationCodesBase<uint64_t>;
+
+    const uint64_t location_code = LC::encode(5, 7, 0, 31);
+    REQUIRE(LC::neighbor_code(location_code, 0, true) == LC::encode(5, 8, 0, 31));
+    REQUIRE(LC::neighbor_code(location_code, 0, false) == LC::encode(5, 6, 0, 31));
+    REQUIRE(LC::neighbor_code(location_code, 1, false) == 0);
+    REQUIRE(LC::neighbor_code(location_code, 2, true) == 0);
+    REQUIRE(LC::neighbor_code(location_code, 2, false) == LC::encode(5, 7, 0, 30));
+    REQUIRE(LocationCodesBase<uint32_t>::neighbor_code(0b1000, 0, true) == 0b1001);
+}
+
+TEST_CASE("Scan integration")
+{
+    using LC = LocationCodesBase<uint32_t>;
+
+    // Depth 6 cells are 8 units wide
+    Octree32 octree(true);
+    octree.integrate_scan(Vertex(4, 4, 4), {Vertex(84, 4, 4)}, 6);
+    REQUIRE(octree.get_volume() == Approx(1 - 10.0f / (1 << 18)));
+    REQUIRE(!octree.is_set(LC::encode(6, 0, 0, 0)));
+    REQUIRE(!octree.is_set(LC::encode(6, 9, 0, 0)));
+    REQUIRE(octree.is_set(LC::encode(6, 10, 0, 0)));
+
+    // A hit on the path of another ray stays set
+    Octree32 empty(false);
+    empty.integrate_scan(Vertex(4, 4, 4), {Vertex(84, 4, 4), Vertex(44, 4, 4)}, 6);
+    REQUIRE(empty.is_set(LC::encode(6, 5, 0, 0)));
+    REQUIRE(empty.get_volume() == Approx(2.0f / (1 << 18)));
+
+    // Diagonal rays clear the same cells as dense sampling along them, and
+    // rays leaving the grid clear up to the boundary without setting anything
+    const Vertex origin(100.5f, 200.25f, 300.75f);
+    const std::vector<Vertex> points = {Vertex(400.3f, 10.7f, 180.2f), Vertex(-50.0f, 350.5f, 700.0f)};
+
+    Octree32 scanned(true);
+    scanned.integrate_scan(origin, points, 6);
+
+    Octree32 sampled(true);
+    for (const Vertex& point : points)
+    {
+        const uint32_t hit_code = LC::encode(6, point.x / 8, point.y / 8, point.z / 8);
+        for (int i = 0; i <= 100000; ++i)
+        {
+            const float t = i / 100000.0f;
+            const float x = origin.x + t * (point.x - origin.x);
+            const float y = origin.y + t * (point.y - origin.y);
+            const float z = origin.z + t * (point.z - origin.z);
+            if (x < 0 || x >= 512 || y < 0 || y >= 512 || z < 0 || z >= 512)
+            {
+                break;
+            }
+
+            const uint32_t location_code = LC::encode(6, x / 8, y / 8, z / 8);
+            if (location_code != hit_code)
+            {
+                sampled.clear(location_code);
+            }
+        }
+    }
+
+    REQUIRE(scanned.get_node_map() == sampled.get_node_map());
+}
+
+TEST_CASE("Payload tree")
+{
+    using LC = LocationCodesBase<uint32_t>;
+
+    PayloadTree<uint32_t, int> tree(-1);
+    REQUIRE(tree.get(LC::encode(4, 1, 2, 3)) == -1);
+    REQUIRE(tree.get_num_nodes() == 1);
+
+    const uint32_t location_code = LC::encode(3, 1, 2, 3);
+    tree.set(location_code, 5);
+    REQUIRE(tree.get(location_code) == 5);
+    REQUIRE(tree.get(LC::child_code(location_code, 4)) == 5);
+    REQUIRE(tree.get(LC::parent_code(location_code)) == std::nullopt);
+    REQUIRE(tree.get_num_nodes() == 3);
+
+    // Updating every region equally collapses nothing, but setting the last
+    // differing region back prunes the whole path
+    tree.update(1, [](int& value) { value *= 2; });
+    REQUIRE(tree.get(location_code) == 10);
+    REQUIRE(tree.get(0b1111) == -2);
+
+    std::vector<std::pair<uint32_t, int>> leaves;
+    tree.for_each_leaf([&](uint32_t leaf, int value) { leaves.push_back({leaf, value}); }, LC::parent_code(location_code));
+    REQUIRE(leaves.size() == 8);
+    REQUIRE(leaves[LC::final_child_index(location_code)].second == 10);
+
+    tree.set(location_code, -2);
+    REQUIRE(tree.get_num_nodes() == 1);
+    REQUIRE(tree.get(0b1000) == -2);
+}
+
+TEST_CASE("Occupancy octree")
+{
+    using LC = LocationCodesBase<uint32_t>;
+
+    OccupancyOctree32 octree;
+    const OccupancyParameters& parameters = octree.get_parameters();
+    const uint32_t location_code = LC::encode(5, 3, 4, 5);
+
+    octree.update(location_code, true);
+    REQUIRE(octree.get_log_odds(location_code) == parameters.hit);
+    REQUIRE(octree.get_probability(location_code).value() == Approx(0.7f).epsilon(0.02));
+    REQUIRE(octree.is_occupied(location_code));
+    REQUIRE(octree.get_occupancy().get_volume() == Approx(1.0f / (1 << 15)));
+
+    // Three misses outweigh one hit
+    for (int i = 0; i < 3; ++i)
+    {
+        octree.update(location_code, false);
+    }
+    REQUIRE(octree.get_log_odds(location_code) == parameters.hit + 3 * parameters.miss);
+    REQUIRE(!octree.is_occupied(location_code));
+    REQUIRE(octree.get_occupancy().get_volume() == 0);
+
+    // Saturating all eight siblings prunes them into one region
+    const uint32_t parent = LC::parent_code(location_code);
+    for (int i = 0; i < 10; ++i)
+    {
+        for (int child = 0; child < 8; ++child)
+        {
+            octree.update(LC::child_code(parent, child), true);
+        }
+    }
+    REQUIRE(octree.get_log_odds(parent) == parameters.max);
+    REQUIRE(octree.get_log_odds_tree().get_num_nodes() == LC::depth(parent));
+    REQUIRE(octree.get_occupancy().get_node_map().size() == LC::depth(parent));
+    REQUIRE(octree.is_occupied(parent));
+
+    // Updating a coarse region applies to every cell within it
+    octree.update(LC::parent_code(parent), false);
+    REQUIRE(octree.get_log_odds(parent) == parameters.max + parameters.miss);
+    REQUIRE(octree.get_log_odds(LC::child_code(LC::parent_code(parent), 0)) == parameters.miss);
+}
+
+struct Rgb
+{
+    uint8_t r, g, b;
+    bool operator==(const Rgb& other) const { return r == other.r && g == other.g && b == other.b; }
+};
+
+TEST_CASE("Attribute channels")
+{
+    using LC = LocationCodesBase<uint32_t>;
+    using LabelledOctree = AttributeOctreeBase<uint32_t, UnorderedMapWrapper, uint16_t, Rgb>;
+
+    LabelledOctree octree;
+    const uint32_t parent = LC::encode(4, 2, 2, 2);
+
+    // Equal attributes collapse with occupancy
+    for (int child = 0; child < 8; ++child)
+    {
+        octree.set(LC::child_code(parent, child), 7, Rgb{255, 0, 0});
+    }
+    REQUIRE(octree.is_set(parent));
+    REQUIRE(octree.get_attribute<0>(parent) == uint16_t(7));
+    REQUIRE(octree.get_attribute<1>(parent) == Rgb{255, 0, 0});
+    REQUIRE(octree.get_channel<0>().get_num_nodes() == LC::depth(parent));
+
+    // One differing colour splits only the colour channel
+    octree.set_attribute<1>(LC::child_code(parent, 3), Rgb{0, 0, 255});
+    REQUIRE(octree.get_attribute<1>(parent) == std::nullopt);
+    REQUIRE(octree.get_attribute<1>(LC::child_code(parent, 3)) == Rgb{0, 0, 255});
+    REQUIRE(octree.get_attribute<0>(parent) == uint16_t(7));
+    REQUIRE(octree.get_channel<0>().get_num_nodes() == LC::depth(parent));
+    REQUIRE(octree.get_channel<1>().get_num_nodes() == LC::depth(parent) + 1);
+    REQUIRE(octree.is_set(parent));
+
+    // Clearing resets attributes so the channels prune back to the root
+    octree.clear(parent);
+    REQUIRE(!octree.is_set(LC::child_code(parent, 0)));
+    REQUIRE(octree.get_attribute<0>(LC::child_code(parent, 0)) == uint16_t(0));
+    REQUIRE(octree.get_channel<0>().get_num_nodes() == 1);
+    REQUIRE(octree.get_channel<1>().get_num_nodes() == 1);
+}
+
+TEST_CASE("Coarsen")
+{
+    using LC = LocationCodesBase<uint32_t>;
+
+    Octree32 octree(false);
+    octree.set_sdf([](const Vertex& v)
+    {
+        return std::sqrt((v.x - 300) * (v.x - 300) + (v.y - 200) * (v.y - 200) + (v.z - 260) * (v.z - 260)) - 150;
+    }, 8);
+    octree.set(LC::encode(2, 0, 0, 0)); // Coarser than the target depth
+
+    for (CoarsenPolicy policy : {CoarsenPolicy::ANY, CoarsenPolicy::MAJORITY, CoarsenPolicy::ALL})
+    {
+        const Octree32 coarse = octree.coarsen(4, policy);
+
+        Octree32 expected(false);
+        const float cell_volume = 1.0f / (1 << 12);
+        for (uint32_t x = 0; x < 16; ++x)
+        {
+            for (uint32_t y = 0; y < 16; ++y)
+            {
+                for (uint32_t z = 0; z < 16; ++z)
+                {
+                    const float volume = octree.volume_in_box({x * 32, y * 32, z * 32}, {x * 32 + 32, y * 32 + 32, z * 32 + 32});
+                    if ((policy == CoarsenPolicy::ANY && volume > 0) ||
+                        (policy == CoarsenPolicy::MAJORITY && volume > cell_volume / 2) ||
+                        volume == cell_volume)
+                    {
+                        expected.set(LC::encode(4, x, y, z));
+                    }
+                }
+            }
+        }
+
+        REQUIRE(coarse.get_node_map() == expected.get_node_map());
+    }
+
+    REQUIRE(octree.coarsen(4, CoarsenPolicy::ALL).get_volume() < octree.get_volume());
+    REQUIRE(octree.coarsen(4, CoarsenPolicy::ANY).get_volume() > octree.get_volume());
+    REQUIRE(octree.coarsen(9).get_node_map() == octree.get_node_map());
+    REQUIRE(octree.coarsen(0).get_volume() == 1.0f);
+}
+
+TEST_CASE("Fill fraction")
+{
+    using LC = LocationCodesBase<uint32_t>;
+
+    Octree32 octree(false);
+    const uint32_t parent = LC::encode(3, 1, 2, 3);
+    octree.set(LC::child_code(parent, 0));
+    octree.set(LC::child_code(LC::child_code(parent, 1), 5));
+    REQUIRE(octree.get_fill_fraction(parent) == 1.0f / 8 + 1.0f / 64);
+    REQUIRE(octree.get_fill_fraction(LC::child_code(parent, 0)) == 1.0f);
+    REQUIRE(octree.get_fill_fraction(LC::child_code(LC::child_code(parent, 0), 3)) == 1.0f);
+    REQUIRE(octree.get_fill_fraction(LC::child_code(parent, 2)) == 0.0f);
+    REQUIRE(octree.get_fill_fraction(1) == octree.get_volume());
+
+    // The cached tree answers like the uncached one through random edits,
+    // including regions erased and recreated
+    Octree32 cached(false);
+    cached.enable_fill_cache(true);
+    Octree32 uncached(false);
+
+    std::mt19937 rng(11);
+    std::uniform_int_distribution<uint32_t> coord(0, 15);
+    std::uniform_int_distribution<int> depth(1, 4);
+
+    for (int i = 0; i < 2000; ++i)
+    {
+        const int d = depth(rng);
+        const uint32_t location_code = LC::encode(d, coord(rng) >> (4 - d), coord(rng) >> (4 - d), coord(rng) >> (4 - d));
+        const bool set = (i % 3 != 0);
+        set ? cached.set(location_code) : cached.clear(location_code);
+        set ? uncached.set(location_code) : uncached.clear(location_code);
+
+        for (uint32_t query = location_code; query != 0; query = LC::parent_code(query))
+        {
+            REQUIRE(cached.get_fill_fraction(query) == uncached.get_fill_fraction(query));
+        }
+
+        const uint32_t other = LC::encode(2, coord(rng) >> 2, coord(rng) >> 2, coord(rng) >> 2);
+        REQUIRE(cached.get_fill_fraction(other) == uncached.get_fill_fraction(other));
+
+        // Entries of erased nodes are dropped with them
+        REQUIRE(cached.get_fill_cache_size() <= cached.get_node_map().size());
+    }
+}
+
+TEST_CASE("Dilate and erode")
+{
+    using LC = LocationCodesBase<uint32_t>;
+
+    Octree32 single(false);
+    single.set(LC::encode(4, 8, 8, 8));
+    REQUIRE(single.dilate(2, 4).get_volume() == Approx(125.0f / (1 << 12)));
+    REQUIRE(single.dilate(2, 4, MorphologyElement::SPHERE).get_volume() == Approx(33.0f / (1 << 12)));
+    REQUIRE(single.dilate(0, 4).get_node_map() == single.get_node_map());
+
+    REQUIRE(Octree32(false).complement().get_volume() == 1.0f);
+    REQUIRE(single.complement().complement().get_node_map() == single.get_node_map());
+
+    // Random blobs, including large regions, against dense morphology
+    Octree32 octree(false);
+    std::mt19937 rng(17);
+    std::uniform_int_distribution<uint32_t> coord(0, 15);
+    for (int i = 0; i < 40; ++i)
+    {
+        octree.set(LC::encode(4, coord(rng), coord(rng), coord(rng)));
+    }
+    octree.set(LC::encode(2, 1, 2, 0));
+    octree.set(LC::encode(1, 1, 1, 1));
+    octree.set(LC::encode(6, 1, 1, 1)); // Partly fills a depth 4 cell
+
+    const Octree32 coarse = octree.coarsen(4);
+    const auto dense = [](const Octree32& tree, int x, int y, int z)
+    {
+        return x >= 0 && x < 16 && y >= 0 && y < 16 && z >= 0 && z < 16 && tree.is_set(LC::encode(4, x, y, z));
+    };
+
+    for (MorphologyElement element : {MorphologyElement::CUBE, MorphologyElement::SPHERE})
+    {
+        for (int radius : {1, 2, 3})
+        {
+            Octree32 dilated(false), eroded(false);
+            for (int x = 0; x < 16; ++x)
+            {
+                for (int y = 0; y < 16; ++y)
+                {
+                    for (int z = 0; z < 16; ++z)
+                    {
+                        bool any = false, all = true;
+                        for (int dx = -radius; dx <= radius; ++dx)
+                        {
+                            for (int dy = -radius; dy <= radius; ++dy)
+                            {
+                                for (int dz = -radius; dz <= radius; ++dz)
+                                {
+                                    if (element == MorphologyElement::SPHERE && dx * dx + dy * dy + dz * dz > radius * radius)
+                                    {
+                                        continue;
+                                    }
+                                    any = any || dense(coarse, x + dx, y + dy, z + dz);
+                                    all = all && dense(octree, x + dx, y + dy, z + dz);
+                                }
+                            }
+                        }
+
+                        if (any)
+                        {
+                            dilated.set(LC::encode(4, x, y, z));
+                        }
+                        if (all)
+                        {
+                            eroded.set(LC::encode(4, x, y, z));
+                        }
+                    }
+                }
+            }
+
+            REQUIRE(octree.dilate(radius, 4, element).get_node_map() == dilated.get_node_map());
+            REQUIRE(octree.erode(radius, 4, element).get_node_map() == eroded.get_node_map());
+        }
+    }
+}
+
+TEST_CASE("Connected components")
+{
+    using LC = LocationCodesBase<uint32_t>;
+
+    // A large region, a small one touching its face, one touching only its
+    // edge and one touching only its corner
+    Octree32 octree(false);
+    octree.set(LC::encode(2, 1, 1, 1));       // Depth 4 cells [4, 8) on each axis
+    octree.set(LC::encode(4, 8, 5, 5));       // Face
+    octree.set(LC::encode(4, 3, 3, 5));       // Edge
+    octree.set(LC::encode(4, 8, 8, 8));       // Corner
+    octree.set(LC::encode(4, 12, 12, 12));    // Apart
+
+    REQUIRE(octree.label_components(Connectivity::FACES).num_components == 4);
+    REQUIRE(octree.label_components(Connectivity::EDGES).num_components == 3);
+    REQUIRE(octree.label_components(Connectivity::CORNERS).num_components == 2);
+
+    const ComponentLabeling<uint32_t> labeling = octree.label_components(Connectivity::CORNERS);
+    REQUIRE(labeling.regions.size() == 5);
+    REQUIRE(labeling.labels.front() == 0);
+    REQUIRE(labeling.labels.back() == 1);
+
+    // Random mixed-size regions against a dense flood fill of depth 4 cells
+    Octree32 random(false);
+    std::mt19937 rng(23);
+    std::uniform_int_distribution<uint32_t> coord(0, 15);
+    for (int i = 0; i < 300; ++i)
+    {
+        random.set(LC::encode(4, coord(rng), coord(rng), coord(rng)));
+    }
+    random.set(LC::encode(2, 0, 3, 1));
+    random.set(LC::encode(3, 5, 2, 6));
+
+    for (Connectivity connectivity : {Connectivity::FACES, Connectivity::EDGES, Connectivity::CORNERS})
+    {
+        const int max_axes = (connectivity == Connectivity::FACES) ? 1 : (connectivity == Connectivity::EDGES) ? 2 : 3;
+        std::vector<int> dense(16 * 16 * 16, -1);
+        int num_components = 0;
+
+        for (int start = 0; start < 16 * 16 * 16; ++start)
+        {
+            if (dense[start] != -1 || !random.is_set(LC::encode(4, start % 16, start / 16 % 16, start / 256)))
+            {
+                continue;
+            }
+
+            std::vector<int> queue = {start};
+            dense[start] = num_components;
+            while (!queue.empty())
+            {
+                const int cell = queue.back();
+                queue.pop_back();
+                const int x = cell % 16, y = cell / 16 % 16, z = cell / 256;
+
+                for (int dx = -1; dx <= 1; ++dx)
+                {
+                    for (int dy = -1; dy <= 1; ++dy)
+                    {
+                        for (int dz = -1; dz <= 1; ++dz)
+                        {
+                            const int nx = x + dx, ny = y + dy, nz = z + dz;
+                            const int num_axes = (dx != 0) + (dy != 0) + (dz != 0);
+                            if (num_axes == 0 || num_axes > max_axes || nx < 0 || nx > 15 || ny < 0 || ny > 15 || nz < 0 || nz > 15)
+                            {
+                                continue;
+                            }
+
+                            const int neighbor = nx + 16 * ny + 256 * nz;
+                            if (dense[neighbor] == -1 && random.is_set(LC::encode(4, nx, ny, nz)))
+                            {
+                                dense[neighbor] = num_components;
+                                queue.push_back(neighbor);
+                            }
+                        }
+                    }
+                }
+            }
+            ++num_components;
+        }
+
+        const ComponentLabeling<uint32_t> labels = random.label_components(connectivity);
+        REQUIRE(labels.num_components == (uint32_t)num_components);
+
+        // Same partition: each component maps to exactly one dense component
+        std::vector<int> dense_of_label(labels.num_components, -1);
+        for (size_t i = 0; i < labels.regions.size(); ++i)
+        {
+            const GridPoint corner = LC::lower_corner_point(labels.regions[i]);
+            const int dense_label = dense[corner.x / 32 + 16 * (corner.y / 32) + 256 * (corner.z / 32)];
+            if (dense_of_label[labels.labels[i]] == -1)
+            {
+                dense_of_label[labels.labels[i]] = dense_label;
+            }
+            REQUIRE(dense_of_label[labels.labels[i]] == dense_label);
+        }
+    }
+}
+
+TEST_CASE("Flood fill")
+{
+    // A closed shell: the cube [128, 384) minus its interior [160, 352)
+    Octree32 shell(false);
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        uint32_t min[3] = {128, 128, 128}, max[3] = {384, 384, 384};
+        max[axis] = 160;
+        shell.set_box({min[0], min[1], min[2]}, {max[0], max[1], max[2]});
+        min[axis] = 352;
+        max[axis] = 384;
+        shell.set_box({min[0], min[1], min[2]}, {max[0], max[1], max[2]});
+    }
+
+    const float cube = 0.5f * 0.5f * 0.5f;
+    const float cavity = 0.375f * 0.375f * 0.375f;
+    REQUIRE(shell.get_volume() == Approx(cube - cavity));
+
+    const Octree32 outside = shell.flood_fill({0, 0, 0});
+    REQUIRE(outside.get_volume() == Approx(1 - cube));
+    const Octree32 inside = shell.flood_fill({256, 256, 256}, Connectivity::CORNERS);
+    REQUIRE(inside.get_volume() == Approx(cavity));
+    REQUIRE(shell.flood_fill({130, 200, 200}).get_volume() == 0);
+    REQUIRE_THROWS(shell.flood_fill({512, 0, 0}));
+    REQUIRE_THROWS(shell.flood_fill({0, 0, 1000}));
+
+    // A hole through the wall joins the cavity to the outside
+    shell.clear(LocationCodesBase<uint32_t>::encode(4, 4, 8, 8));
+    REQUIRE(shell.flood_fill({0, 0, 0}).get_node_map() == shell.flood_fill({256, 256, 256}).get_node_map());
+
+    // Agrees with the component of the seed among the unset regions
+    Octree32 random(false);
+    std::mt19937 rng(29);
+    std::uniform_int_distribution<uint32_t> coord(0, 15);
+    for (int i = 0; i < 1500; ++i)
+    {
+        random.set(LocationCodesBase<uint32_t>::encode(4, coord(rng), coord(rng), coord(rng)));
+    }
+
+    for (Connectivity connectivity : {Connectivity::FACES, Connectivity::CORNERS})
+    {
+        const ComponentLabeling<uint32_t> labeling = random.complement().label_components(connectivity);
+        const uint32_t seed_label = labeling.labels.front();
+        const GridPoint seed = LocationCodesBase<uint32_t>::lower_corner_point(labeling.regions.front());
+
+        Octree32 expected(false);
+        for (size_t i = 0; i < labeling.regions.size(); ++i)
+        {
+            if (labeling.labels[i] == seed_label)
+            {
+                expected.set(labeling.regions[i]);
+            }
+        }
+
+        REQUIRE(random.flood_fill(seed, connectivity).get_node_map() == expected.get_node_map());
+    }
+}
+
+TEST_CASE("Surface area")
+{
+    using LC = LocationCodesBase<uint32_t>;
+
+    Octree32 octree(false);
+    REQUIRE(octree.get_surface_area() == 0);
+    octree.set(0b1000);
+    REQUIRE(octree.get_surface_area() == 1.5f);
+    octree.set(0b1001);
+    REQUIRE(octree.get_surface_area() == 2.5f);
+    octree.set_root();
+    REQUIRE(octree.get_surface_area() == 6.0f);
+    octree.clear(0b1000);
+    REQUIRE(octree.get_surface_area() == 6.0f); // Removing a corner octant
+
+    // Tracked and recomputed areas agree with a dense count of depth 4 faces
+    Octree32 tracked(false), untracked(false);
+    tracked.enable_surface_tracking(true);
+
+    std::mt19937 rng(31);
+    std::uniform_int_distribution<uint32_t> coord(0, 15);
+    std::uniform_int_distribution<int> depth(1, 4);
+
+    for (int i = 0; i < 600; ++i)
+    {
+        const int d = depth(rng);
+        const uint32_t location_code = LC::encode(d, coord(rng) >> (4 - d), coord(rng) >> (4 - d), coord(rng) >> (4 - d));
+        const bool set = (i % 3 != 0);
+        set ? tracked.set(location_code) : tracked.clear(location_code);
+        set ? untracked.set(location_code) : untracked.clear(location_code);
+        REQUIRE(tracked.get_surface_area() == untracked.get_surface_area());
+
+        if (i % 50 == 0)
+        {
+            const auto dense = [&](int x, int y, int z)
+            {
+                return x >= 0 && x < 16 && y >= 0 && y < 16 && z >= 0 && z < 16 && untracked.is_set(LC::encode(4, x, y, z));
+            };
+
+            int num_faces = 0;
+            for (int x = 0; x < 16; ++x)
+            {
+                for (int y = 0; y < 16; ++y)
+                {
+                    for (int z = 0; z < 16; ++z)
+                    {
+                        if (dense(x, y, z))
+                        {
+                            num_faces += !dense(x - 1, y, z) + !dense(x + 1, y, z) + !dense(x, y - 1, z) +
+                                !dense(x, y + 1, z) + !dense(x, y, z - 1) + !dense(x, y, z + 1);
+                        }
+                    }
+                }
+            }
+
+            REQUIRE(untracked.get_surface_area() == num_faces / 256.0f);
+        }
+    }
+
+    REQUIRE(tracked.complement().get_surface_area() == tracked.complement().coarsen(9).get_surface_area());
+
+    // Setting or clearing the root replaces the tracked area outright
+    Octree32 root(false);
+    root.enable_surface_tracking(true);
+    root.set(LC::encode(4, 3, 3, 3));
+    REQUIRE(root.get_surface_area() == 6 / 256.0f);
+    root.set(1);
+    REQUIRE(root.get_surface_area() == 6.0f);
+    root.clear(1);
+    REQUIRE(root.get_surface_area() == 0);
+    root.set(LC::encode(4, 3, 3, 3));
+    REQUIRE(root.get_surface_area() == 6 / 256.0f);
+}
+
+#ifdef OCTREE_ENABLE_STATS
+TEST_CASE("Hot-path counters")
+{
+    Octree32 octree(false);
+    octree.set(0b1000111000111101010111);
+    REQUIRE(octree.get_stats().emplace_hits[0] == 1);
+    REQUIRE(octree.get_stats().emplace_misses[6] == 1);
+
+    octree.set(0b1000111000111101010110);
+    REQUIRE(octree.get_stats().emplace_hits[6] == 1);
+
+    octree.reset_stats();
+    for (uint32_t child = 0b1000000; child <= 0b1000111; ++child)
+    {
+        octree.set(child);
+    }
+    REQUIRE(octree.get_stats().collapse_steps == 1);
+    REQUIRE(octree.get_stats().erase_sizes[2] == 1); // The 5 node chain from 0b1000111
+
+    octree.set(0b1000111000111101010111);
+    REQUIRE(octree.get_stats().ancestor_set_returns == 1);
+
+    std::ostringstream oss;
+    octree.get_stats().dump(oss);
+    REQUIRE(oss.str().find("collapse_steps 1\n") != std::string::npos);
+}
+#else
+TEST_CASE("Hot-path counters disabled")
+{
+    Octree32 octree(false);
+    octree.set(0b1000111000111101010111);
+    octree.clear(0b1000111000111101010111);
+
+    std::ostringstream oss;
+    octree.get_stats().dump(oss);
+    REQUIRE(oss.str() == "ancestor_set_returns 0\ncollapse_steps 0\n");
+    REQUIRE(sizeof(Octree32) < sizeof(OctreeStats)); // No counters per tree
+}
+#endif
@@ -0,0 +1,49 @@
+#ifndef _PARALLEL_H_
+#define _PARALLEL_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Calls function(i) for every i in [begin, end), splitting the range into one
+// contiguous chunk per hardware thread. Small ranges run on the calling thread.
+template <typename Function>
+void parallel_for(size_t begin, size_t end, Function function, size_t min_chunk_size=64)
+{
+    const size_t count = (end > begin) ? end - begin : 0;
+    const size_t max_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    const size_t num_threads = std::min(max_threads, count / std::max<size_t>(1, min_chunk_size));
+
+    if (num_threads <= 1)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            function(i);
+        }
+        return;
+    }
+
+    const size_t chunk_size = (count + num_threads - 1) / num_threads;
+    std::vector<std::thread> threads;
+    threads.reserve(num_threads);
+
+    for (size_t chunk_begin = begin; chunk_begin < end; chunk_begin += chunk_size)
+    {
+        const size_t chunk_end = std::min(end, chunk_begin + chunk_size);
+        threads.emplace_back([&function, chunk_begin, chunk_end]()
+        {
+            for (size_t i = chunk_begin; i < chunk_end; ++i)
+            {
+                function(i);
+            }
+        });
+    }
+
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+#endif // _PARALLEL_H_
@@ -0,0 +1,72 @@
+#ifndef _PAYLOAD_TREE_H_
+#define _PAYLOAD_TREE_H_
+
+#include <array>
+#include <cstdint>
+#include <optional>
+
+#include "octree.h"
+
+template <typename Payload>
+struct PayloadNode
+{
+    std::array<Payload, 8> values; // Value of each child region without a node
+    uint8_t child_exists = 0;
+
+    bool operator==(const PayloadNode& other) const
+    {
+        return child_exists == other.child_exists && values == other.values;
+    }
+};
+
+// Hashed octree holding a value for every region, laid out like OctreeBase:
+// a map from location code to node, where each child is either a node of its
+// own or a uniform region with a single value. Nodes whose eight children are
+// uniform with equal values are pruned into their parent, so large saturated
+// or unobserved regions cost nothing. Payload needs operator==.
+template <typename LocationCode, typename Payload, typename MapWrapper=UnorderedMapWrapper>
+class PayloadTree
+{
+public:
+
+    using NodeMapType = typename MapWrapper::template TypeDecl<LocationCode, PayloadNode<Payload>>::Type;
+    using LocationCodes = LocationCodesBase<LocationCode>;
+    using LocationCodeType = LocationCode;
+
+    explicit PayloadTree(const Payload& background=Payload());
+
+    // Value of the uniform region containing location_code, or nullopt if the
+    // region is split into differing values
+    std::optional<Payload> get(LocationCode location_code) const;
+
+    // Assigns a single value to the whole region
+    void set(LocationCode location_code, const Payload& value);
+
+    // Calls function(Payload&) on each uniform region within location_code,
+    // then prunes whatever became uniform
+    template <typename Function>
+    void update(LocationCode location_code, Function&& function);
+
+    // Calls function(location_code, value) for each uniform region within
+    // location_code, in Morton order
+    template <typename Function>
+    void for_each_leaf(Function&& function, LocationCode location_code=1) const;
+
+    const NodeMapType& get_node_map() const { return _nodes; }
+    int get_num_nodes() const { return _nodes.size(); }
+
+private:
+
+    PayloadNode<Payload>* split_to_parent(LocationCode location_code);
+    template <typename Function>
+    void update_subtree(LocationCode location_code, Function& function);
+    void erase_subtree(LocationCode location_code);
+    bool try_prune(LocationCode location_code);
+    void prune_path(LocationCode location_code);
+
+    NodeMapType _nodes;
+};
+
+#include "payload_tree.inl.h"
+
+#endif // _PAYLOAD_TREE_H_
@@ -0,0 +1,244 @@
+#include <algorithm>
+
+#include "payload_tree.h"
+
+template <typename LocationCode, typename Payload, typename MapWrapper>
+PayloadTree<LocationCode, Payload, MapWrapper>::PayloadTree(const Payload& background)
+{
+    PayloadNode<Payload> root;
+    root.values.fill(background);
+    _nodes.emplace(1, root);
+}
+
+template <typename LocationCode, typename Payload, typename MapWrapper>
+std::optional<Payload> PayloadTree<LocationCode, Payload, MapWrapper>::get(LocationCode location_code) const
+{
+    const int depth = LocationCodes::depth(location_code);
+    const PayloadNode<Payload>* node = &_nodes.find(1)->second;
+
+    for (int level = 0; level < depth; ++level)
+    {
+        const LocationCode child_location_code = location_code >> 3 * (depth - level - 1);
+        const int child_index = LocationCodes::final_child_index(child_location_code);
+
+        if (!(node->child_exists & (1 << child_index)))
+        {
+            return node->values[child_index];
+        }
+
+        node = &_nodes.find(child_location_code)->second;
+    }
+
+    return std::nullopt; // The region itself is a node
+}
+
+template <typename LocationCode, typename Payload, typename MapWrapper>
+void PayloadTree<LocationCode, Payload, MapWrapper>::set(LocationCode location_code, const Payload& value)
+{
+    if (location_code == 1)
+    {
+        _nodes.clear();
+        MapWrapper::release(_nodes);
+
+        PayloadNode<Payload> root;
+        root.values.fill(value);
+        _nodes.emplace(1, root);
+        return;
+    }
+
+    PayloadNode<Payload>* parent = split_to_parent(location_code);
+    const int child_index = LocationCodes::final_child_index(location_code);
+
+    if (parent->child_exists & (1 << child_index))
+    {
+        erase_subtree(location_code);
+        parent->child_exists &= ~(1 << child_index);
+    }
+    parent->values[child_index] = value;
+
+    prune_path(LocationCodes::parent_code(location_code));
+}
+
+template <typename LocationCode, typename Payload, typename MapWrapper>
+template <typename Function>
+void PayloadTree<LocationCode, Payload, MapWrapper>::update(LocationCode location_code, Function&& function)
+{
+    if (location_code == 1)
+    {
+        update_subtree(1, function);
+        return;
+    }
+
+    PayloadNode<Payload>* parent = split_to_parent(location_code);
+    const int child_index = LocationCodes::final_child_index(location_code);
+
+    if (parent->child_exists & (1 << child_index))
+    {
+        update_subtree(location_code, function);
+        try_prune(location_code);
+    }
+    else
+    {
+        function(parent->values[child_index]);
+    }
+
+    prune_path(LocationCodes::parent_code(location_code));
+}
+
+template <typename LocationCode, typename Payload, typename MapWrapper>
+template <typename Function>
+void PayloadTree<LocationCode, Payload, MapWrapper>::for_each_leaf(Function&& function, LocationCode location_code) const
+{
+    const int depth = LocationCodes::depth(location_code);
+    const PayloadNode<Payload>* node = &_nodes.find(1)->second;
+
+    for (int level = 0; level < depth; ++level)
+    {
+        const LocationCode child_location_code = location_code >> 3 * (depth - level - 1);
+        const int child_index = LocationCodes::final_child_index(child_location_code);
+
+        if (!(node->child_exists & (1 << child_index)))
+        {
+            function(location_code, node->values[child_index]); // Covered by a larger region
+            return;
+        }
+
+        node = &_nodes.find(child_location_code)->second;
+    }
+
+    struct Frame
+    {
+        LocationCode location_code;
+        const PayloadNode<Payload>* node;
+        uint8_t next_child;
+    };
+
+    std::array<Frame, LocationCodes::max_depth() + 1> stack;
+    size_t size = 0;
+    stack[size++] = Frame{location_code, node, 0};
+
+    while (size > 0)
+    {
+        Frame& frame = stack[size - 1];
+
+        if (frame.next_child == 8)
+        {
+            --size;
+            continue;
+        }
+
+        const int child_index = frame.next_child++;
+        const LocationCode child_location_code = LocationCodes::child_code(frame.location_code, child_index);
+
+        if (frame.node->child_exists & (1 << child_index))
+        {
+            stack[size++] = Frame{child_location_code, &_nodes.find(child_location_code)->second, 0};
+        }
+        else
+        {
+            function(child_location_code, frame.node->values[child_index]);
+        }
+    }
+}
+
+// Returns the parent node of location_code, splitting uniform ancestors into
+// nodes whose children all carry the ancestor's value
+template <typename LocationCode, typename Payload, typename MapWrapper>
+PayloadNode<Payload>* PayloadTree<LocationCode, Payload, MapWrapper>::split_to_parent(LocationCode location_code)
+{
+    const int parent_depth = LocationCodes::depth(location_code) - 1;
+    PayloadNode<Payload>* node = &_nodes.find(1)->second;
+
+    for (int level = 0; level < parent_depth; ++level)
+    {
+        const LocationCode child_location_code = location_code >> 3 * (parent_depth - level);
+        const int child_index = LocationCodes::final_child_index(child_location_code);
+
+        if (node->child_exists & (1 << child_index))
+        {
+            node = &_nodes.find(child_location_code)->second;
+        }
+        else
+        {
+            PayloadNode<Payload> child;
+            child.values.fill(node->values[child_index]);
+            node->child_exists |= (1 << child_index);
+            node = &_nodes.emplace(child_location_code, child).first->second;
+        }
+    }
+
+    return node;
+}
+
+template <typename LocationCode, typename Payload, typename MapWrapper>
+template <typename Function>
+void PayloadTree<LocationCode, Payload, MapWrapper>::update_subtree(LocationCode location_code, Function& function)
+{
+    PayloadNode<Payload>& node = _nodes.find(location_code)->second;
+
+    for (int i = 0; i < 8; ++i)
+    {
+        if (node.child_exists & (1 << i))
+        {
+            const LocationCode child_location_code = LocationCodes::child_code(location_code, i);
+            update_subtree(child_location_code, function);
+            try_prune(child_location_code);
+        }
+        else
+        {
+            function(node.values[i]);
+        }
+    }
+}
+
+template <typename LocationCode, typename Payload, typename MapWrapper>
+void PayloadTree<LocationCode, Payload, MapWrapper>::erase_subtree(LocationCode location_code)
+{
+    const auto it = _nodes.find(location_code);
+
+    for (int i = 0; i < 8; ++i)
+    {
+        if (it->second.child_exists & (1 << i))
+        {
+            erase_subtree(LocationCodes::child_code(location_code, i));
+        }
+    }
+
+    _nodes.erase(it);
+}
+
+// Folds a node of eight equal uniform children into its parent
+template <typename LocationCode, typename Payload, typename MapWrapper>
+bool PayloadTree<LocationCode, Payload, MapWrapper>::try_prune(LocationCode location_code)
+{
+    if (location_code == 1)
+    {
+        return false;
+    }
+
+    const auto it = _nodes.find(location_code);
+    const PayloadNode<Payload>& node = it->second;
+
+    if (node.child_exists != 0 ||
+        !std::all_of(node.values.begin() + 1, node.values.end(), [&](const Payload& value) { return value == node.values[0]; }))
+    {
+        return false;
+    }
+
+    PayloadNode<Payload>& parent = _nodes.find(LocationCodes::parent_code(location_code))->second;
+    const int child_index = LocationCodes::final_child_index(location_code);
+    parent.values[child_index] = node.values[0];
+    parent.child_exists &= ~(1 << child_index);
+    _nodes.erase(it);
+
+    return true;
+}
+
+template <typename LocationCode, typename Payload, typename MapWrapper>
+void PayloadTree<LocationCode, Payload, MapWrapper>::prune_path(LocationCode location_code)
+{
+    while (try_prune(location_code))
+    {
+        location_code = LocationCodes::parent_code(location_code);
+    }
+}
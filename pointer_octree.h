@@ -0,0 +1,91 @@
+#ifndef _POINTER_OCTREE_H_
+#define _POINTER_OCTREE_H_
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "octree.h"
+
+// An octree stored as a contiguous pool of nodes. Each node keeps the usual
+// NodeType mask plus the index of its first child; existing children sit in
+// consecutive slots, ordered by child index, so a child is found by popcount
+// rather than by hashing its location code.
+template <typename LocationCode>
+class PointerOctreeBase
+{
+public:
+
+    using LocationCodes = LocationCodesBase<LocationCode>;
+    using LocationCodeType = LocationCode;
+
+    struct PoolNode
+    {
+        NodeType node;
+        uint32_t first_child;
+    };
+
+    PointerOctreeBase(bool full=false, size_t capacity=0);
+
+    template <typename MapWrapper>
+    explicit PointerOctreeBase(const OctreeBase<LocationCode, MapWrapper>& octree);
+
+    template <typename MapWrapper>
+    OctreeBase<LocationCode, MapWrapper> to_octree() const;
+
+    void reserve(size_t capacity);
+
+    void set_root();
+    void clear_root();
+
+    void set(LocationCode location_code);
+    void clear(LocationCode location_code);
+
+    bool is_set(LocationCode location_code) const;
+
+    float get_volume() const;
+
+    OptionalNodeType get_node(LocationCode location_code) const;
+
+    // Same hooks and order as OctreeBase::traverse()
+    template <typename Visitor>
+    void traverse(Visitor& visitor, LocationCode location_code=1) const;
+
+    // Calls function(location_code, depth) for every set region, in Morton order
+    template <typename Function>
+    void for_each_set(Function&& function) const;
+
+    // Distance along the ray to the first set region hit, if within max_distance
+    std::optional<float> raycast(const Vertex& origin, const Vertex& direction, float max_distance) const;
+
+    const std::vector<PoolNode>& get_pool() const { return _pool; }
+
+    static constexpr size_t get_max_depth() { return LocationCodes::max_depth(); }
+    int get_num_nodes() const { return 1 + _num_nodes; }
+
+private:
+
+    static constexpr uint32_t NO_NODE = ~uint32_t(0);
+
+    uint32_t child_slot(uint32_t index, int child_index) const;
+    uint32_t find_node(LocationCode location_code) const;
+
+    uint32_t allocate(int size);
+    void release(uint32_t start, int size);
+    void resize_children(uint32_t index, NodeType new_node);
+
+    uint32_t add_child(uint32_t index, int child_index, NodeType child_node);
+    void remove_child(uint32_t index, int child_index);
+
+    std::vector<PoolNode> _pool;
+    std::array<std::vector<uint32_t>, 9> _free_blocks; // Released child blocks by size
+    size_t _num_nodes; // Including the root, as in OctreeBase's node map
+};
+
+using PointerOctree32 = PointerOctreeBase<uint32_t>;
+using PointerOctree64 = PointerOctreeBase<uint64_t>;
+
+#include "pointer_octree.inl.h"
+
+#endif // _POINTER_OCTREE_H_
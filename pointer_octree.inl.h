@@ -0,0 +1,454 @@
+#include "pointer_octree.h"
+#include "raycast.h"
+
+template <typename LocationCode>
+PointerOctreeBase<LocationCode>::PointerOctreeBase(bool full, size_t capacity)
+{
+    full ? set_root() : clear_root();
+    reserve(capacity);
+}
+
+template <typename LocationCode>
+template <typename MapWrapper>
+PointerOctreeBase<LocationCode>::PointerOctreeBase(const OctreeBase<LocationCode, MapWrapper>& octree)
+{
+    clear_root();
+    reserve(octree.get_num_nodes());
+
+    // Pre-order: each node's slot is reserved in its parent's child block
+    // before the node itself is entered.
+    struct Visitor : OctreeVisitor<LocationCode>
+    {
+        Visitor(PointerOctreeBase& tree) : tree(tree) {}
+
+        void enter_node(LocationCode location_code, NodeType node)
+        {
+            const int depth = LocationCodes::depth(location_code);
+            const uint32_t index = (depth == 0) ? 0 : tree.child_slot(
+                indices[depth - 1], LocationCodes::final_child_index(location_code)
+            );
+
+            const int num_children = bit_count(node & 0xff);
+            const uint32_t first_child = (num_children > 0) ? tree.allocate(num_children) : 0;
+
+            tree._pool[index] = PoolNode{node, first_child};
+            tree._num_nodes += (depth == 0) ? 0 : 1; // The root is already counted
+            indices[depth] = index;
+        }
+
+        PointerOctreeBase& tree;
+        std::array<uint32_t, LocationCodes::max_depth()> indices;
+    } visitor(*this);
+
+    octree.traverse(visitor);
+}
+
+template <typename LocationCode>
+template <typename MapWrapper>
+OctreeBase<LocationCode, MapWrapper> PointerOctreeBase<LocationCode>::to_octree() const
+{
+    OctreeBase<LocationCode, MapWrapper> result(false, _num_nodes);
+
+    // Post-order, so that create_node() only ever builds paths through
+    // ancestors whose final values have not been written yet
+    struct Visitor : OctreeVisitor<LocationCode>
+    {
+        Visitor(OctreeBase<LocationCode, MapWrapper>& result) : result(result) {}
+
+        void exit_node(LocationCode location_code, NodeType node)
+        {
+            *result.create_node(location_code) = node;
+        }
+
+        OctreeBase<LocationCode, MapWrapper>& result;
+    } visitor(result);
+
+    traverse(visitor);
+    return result;
+}
+
+template <typename LocationCode>
+void PointerOctreeBase<LocationCode>::reserve(size_t capacity)
+{
+    _pool.reserve(capacity);
+}
+
+template <typename LocationCode>
+void PointerOctreeBase<LocationCode>::set_root()
+{
+    _pool.assign(1, PoolNode{ALL_CHILDREN_SET, 0});
+    _free_blocks = {};
+    _num_nodes = 1;
+}
+
+template <typename LocationCode>
+void PointerOctreeBase<LocationCode>::clear_root()
+{
+    _pool.assign(1, PoolNode{0, 0});
+    _free_blocks = {};
+    _num_nodes = 1;
+}
+
+template <typename LocationCode>
+uint32_t PointerOctreeBase<LocationCode>::child_slot(uint32_t index, int child_index) const
+{
+    const PoolNode& pool_node = _pool[index];
+    return pool_node.first_child + bit_count(pool_node.node & 0xff & ((1u << child_index) - 1));
+}
+
+template <typename LocationCode>
+uint32_t PointerOctreeBase<LocationCode>::find_node(LocationCode location_code) const
+{
+    const int depth = LocationCodes::depth(location_code);
+    uint32_t index = 0;
+
+    for (int level = 0; level < depth; ++level)
+    {
+        const int child_index = LocationCodes::final_child_index(location_code >> 3 * (depth - level - 1));
+
+        if (!get_child_exists(_pool[index].node, child_index))
+        {
+            return NO_NODE;
+        }
+
+        index = child_slot(index, child_index);
+    }
+
+    return index;
+}
+
+template <typename LocationCode>
+uint32_t PointerOctreeBase<LocationCode>::allocate(int size)
+{
+    std::vector<uint32_t>& free_blocks = _free_blocks[size];
+
+    if (!free_blocks.empty())
+    {
+        const uint32_t start = free_blocks.back();
+        free_blocks.pop_back();
+        return start;
+    }
+
+    const uint32_t start = _pool.size();
+    _pool.resize(_pool.size() + size);
+    return start;
+}
+
+template <typename LocationCode>
+void PointerOctreeBase<LocationCode>::release(uint32_t start, int size)
+{
+    if (size > 0)
+    {
+        _free_blocks[size].push_back(start);
+    }
+}
+
+template <typename LocationCode>
+void PointerOctreeBase<LocationCode>::resize_children(uint32_t index, NodeType new_node)
+{
+    // Moves the node's children into a block sized for new_node's existing
+    // children. A newly existing child's slot is left for the caller to fill.
+    const NodeType old_node = _pool[index].node;
+    const uint32_t old_first = _pool[index].first_child;
+    const int new_size = bit_count(new_node & 0xff);
+    const uint32_t new_first = (new_size > 0) ? allocate(new_size) : 0;
+
+    uint32_t old_slot = old_first;
+    uint32_t new_slot = new_first;
+
+    for (int i = 0; i < 8; ++i)
+    {
+        const bool old_exists = get_child_exists(old_node, i);
+        const bool new_exists = get_child_exists(new_node, i);
+
+        if (old_exists && new_exists)
+        {
+            _pool[new_slot] = _pool[old_slot];
+        }
+        old_slot += old_exists;
+        new_slot += new_exists;
+    }
+
+    release(old_first, bit_count(old_node & 0xff));
+    _pool[index] = PoolNode{new_node, new_first};
+}
+
+template <typename LocationCode>
+uint32_t PointerOctreeBase<LocationCode>::add_child(uint32_t index, int child_index, NodeType child_node)
+{
+    NodeType new_node = _pool[index].node;
+    set_child_exists(new_node, child_index);
+    resize_children(index, new_node);
+
+    const uint32_t slot = child_slot(index, child_index);
+    _pool[slot] = PoolNode{child_node, 0};
+    ++_num_nodes;
+    return slot;
+}
+
+template <typename LocationCode>
+void PointerOctreeBase<LocationCode>::remove_child(uint32_t index, int child_index)
+{
+    // Release every block below the child, then drop it from the parent
+    std::vector<uint32_t> stack = {child_slot(index, child_index)};
+
+    while (!stack.empty())
+    {
+        const PoolNode pool_node = _pool[stack.back()];
+        stack.pop_back();
+        --_num_nodes;
+
+        const int num_children = bit_count(pool_node.node & 0xff);
+        for (int i = 0; i < num_children; ++i)
+        {
+            stack.push_back(pool_node.first_child + i);
+        }
+        release(pool_node.first_child, num_children);
+    }
+
+    NodeType new_node = _pool[index].node;
+    clear_child(new_node, child_index);
+    resize_children(index, new_node);
+}
+
+template <typename LocationCode>
+void PointerOctreeBase<LocationCode>::set(LocationCode location_code)
+{
+    if (location_code == 1) // Root - there is no parent
+    {
+        set_root();
+        return;
+    }
+
+    const int depth = LocationCodes::depth(location_code);
+    std::array<uint32_t, LocationCodes::max_depth()> path;
+    path[0] = 0;
+
+    // Iterate down from the root to the parent
+    for (int level = 0; level < depth - 1; ++level)
+    {
+        const int child_index = LocationCodes::final_child_index(location_code >> 3 * (depth - level - 1));
+        const NodeType node = _pool[path[level]].node;
+
+        if (get_child_exists(node, child_index))
+        {
+            path[level + 1] = child_slot(path[level], child_index);
+        }
+        else if (get_child_set_if_not_exists(node, child_index))
+        {
+            return; // This child is already set fully; no need to traverse
+        }
+        else
+        {
+            path[level + 1] = add_child(path[level], child_index, 0);
+        }
+    }
+
+    // Now we are at the parent depth
+    const int child_index = LocationCodes::final_child_index(location_code);
+    uint32_t parent = path[depth - 1];
+
+    if (get_child_exists(_pool[parent].node, child_index))
+    {
+        remove_child(parent, child_index);
+    }
+    set_child_value(_pool[parent].node, child_index);
+
+    // Collapse ancestors that have become fully set
+    for (int level = depth - 1; level > 0 && _pool[path[level]].node == ALL_CHILDREN_SET; --level)
+    {
+        const int ancestor_index = LocationCodes::final_child_index(location_code >> 3 * (depth - level));
+        remove_child(path[level - 1], ancestor_index);
+        set_child_value(_pool[path[level - 1]].node, ancestor_index);
+    }
+}
+
+template <typename LocationCode>
+void PointerOctreeBase<LocationCode>::clear(LocationCode location_code)
+{
+    if (location_code == 1) // Root - there is no parent
+    {
+        clear_root();
+        return;
+    }
+
+    const int depth = LocationCodes::depth(location_code);
+    std::array<uint32_t, LocationCodes::max_depth()> path;
+    path[0] = 0;
+
+    // Iterate down from the root to the parent, splitting set ancestors
+    for (int level = 0; level < depth - 1; ++level)
+    {
+        const int child_index = LocationCodes::final_child_index(location_code >> 3 * (depth - level - 1));
+        const NodeType node = _pool[path[level]].node;
+
+        if (get_child_exists(node, child_index))
+        {
+            path[level + 1] = child_slot(path[level], child_index);
+        }
+        else if (get_child_set_if_not_exists(node, child_index))
+        {
+            path[level + 1] = add_child(path[level], child_index, ALL_CHILDREN_SET);
+        }
+        else
+        {
+            return; // This child is already empty; no need to traverse
+        }
+    }
+
+    // Now we are at the parent depth
+    const int child_index = LocationCodes::final_child_index(location_code);
+    const uint32_t parent = path[depth - 1];
+
+    if (get_child_exists(_pool[parent].node, child_index))
+    {
+        remove_child(parent, child_index);
+    }
+    clear_child(_pool[parent].node, child_index);
+
+    // Remove ancestors left with no children at all
+    for (int level = depth - 1; level > 0 && _pool[path[level]].node == 0; --level)
+    {
+        remove_child(path[level - 1], LocationCodes::final_child_index(location_code >> 3 * (depth - level)));
+    }
+}
+
+template <typename LocationCode>
+bool PointerOctreeBase<LocationCode>::is_set(LocationCode location_code) const
+{
+    const int depth = LocationCodes::depth(location_code);
+    uint32_t index = 0;
+
+    if (depth == 0)
+    {
+        return _pool[0].node == ALL_CHILDREN_SET;
+    }
+
+    for (int level = 0; level < depth; ++level)
+    {
+        const int child_index = LocationCodes::final_child_index(location_code >> 3 * (depth - level - 1));
+        const NodeType node = _pool[index].node;
+
+        if (!get_child_exists(node, child_index))
+        {
+            return get_child_set_if_not_exists(node, child_index);
+        }
+
+        index = child_slot(index, child_index);
+    }
+
+    return false;
+}
+
+template <typename LocationCode>
+OptionalNodeType PointerOctreeBase<LocationCode>::get_node(LocationCode location_code) const
+{
+    const uint32_t index = find_node(location_code);
+    return (index == NO_NODE) ? std::nullopt : OptionalNodeType(_pool[index].node);
+}
+
+template <typename LocationCode>
+template <typename Visitor>
+void PointerOctreeBase<LocationCode>::traverse(Visitor& visitor, LocationCode location_code) const
+{
+    struct Frame
+    {
+        LocationCode location_code;
+        uint32_t index;
+        uint8_t next_child;
+    };
+
+    const uint32_t start = find_node(location_code);
+    if (start == NO_NODE)
+    {
+        return;
+    }
+
+    std::array<Frame, LocationCodes::max_depth()> stack;
+    size_t size = 0;
+
+    stack[size++] = Frame{location_code, start, 0};
+    visitor.enter_node(location_code, _pool[start].node);
+
+    while (size > 0)
+    {
+        Frame& frame = stack[size - 1];
+        const PoolNode& pool_node = _pool[frame.index];
+
+        const unsigned remaining = ((pool_node.node | (pool_node.node >> 8)) & 0xff) >> frame.next_child;
+        if (remaining == 0)
+        {
+            visitor.exit_node(frame.location_code, pool_node.node);
+            --size;
+            continue;
+        }
+
+        const int i = frame.next_child + low_bit_index(remaining);
+        frame.next_child = i + 1;
+        const LocationCode child_code = LocationCodes::child_code(frame.location_code, i);
+
+        if (!get_child_exists(pool_node.node, i))
+        {
+            visitor.set_child(child_code);
+        }
+        else if (!visitor.prune(child_code))
+        {
+            const uint32_t child_index = child_slot(frame.index, i);
+            stack[size++] = Frame{child_code, child_index, 0};
+            visitor.enter_node(child_code, _pool[child_index].node);
+        }
+    }
+}
+
+template <typename LocationCode>
+template <typename Function>
+void PointerOctreeBase<LocationCode>::for_each_set(Function&& function) const
+{
+    struct Visitor : OctreeVisitor<LocationCode>
+    {
+        Visitor(Function& function) : function(function) {}
+
+        void set_child(LocationCode location_code)
+        {
+            function(location_code, LocationCodes::depth(location_code));
+        }
+
+        Function& function;
+    } visitor(function);
+
+    traverse(visitor);
+}
+
+template <typename LocationCode>
+float PointerOctreeBase<LocationCode>::get_volume() const
+{
+    struct Visitor : OctreeVisitor<LocationCode>
+    {
+        void set_child(LocationCode location_code)
+        {
+            volume += (LocationCode(1) << (8 * sizeof(LocationCode) - 1)) >> 3 * LocationCodes::depth(location_code);
+        }
+
+        LocationCode volume = 0;
+    } visitor;
+
+    traverse(visitor);
+    return (float)visitor.volume / (LocationCode(1) << (8 * sizeof(LocationCode) - 1));
+}
+
+template <typename LocationCode>
+std::optional<float> PointerOctreeBase<LocationCode>::raycast(const Vertex& origin, const Vertex& direction, float max_distance) const
+{
+    struct Accessor
+    {
+        using Handle = uint32_t;
+
+        Handle root() const { return 0; }
+        NodeType node(Handle handle) const { return tree._pool[handle].node; }
+        Handle child(Handle handle, NodeType node, int child_index) const { return tree.child_slot(handle, child_index); }
+
+        const PointerOctreeBase& tree;
+    } accessor{*this};
+
+    return RayCaster<LocationCodes, Accessor>(accessor, origin, direction, max_distance).cast();
+}
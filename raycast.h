@@ -0,0 +1,145 @@
+#ifndef _RAYCAST_H_
+#define _RAYCAST_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <optional>
+
+#include "octree.h"
+
+// Front-to-back ray traversal shared by the octree representations. The
+// accessor exposes the tree as opaque node handles:
+//
+//     using Handle = ...;
+//     Handle root() const;
+//     NodeType node(Handle handle) const;
+//     Handle child(Handle handle, NodeType node, int child_index) const;
+//
+// Positions and distances are in units of max-depth cells.
+template <typename LocationCodes, typename Accessor>
+class RayCaster
+{
+public:
+
+    using Handle = typename Accessor::Handle;
+
+    RayCaster(const Accessor& accessor, const Vertex& origin, const Vertex& direction, float max_distance) :
+        _accessor(accessor),
+        _max_distance(max_distance),
+        _direction_mask(0)
+    {
+        const float length = std::sqrt(
+            direction.x * direction.x + direction.y * direction.y + direction.z * direction.z
+        );
+        const float origin_coords[3] = {origin.x, origin.y, origin.z};
+        const float direction_coords[3] = {direction.x, direction.y, direction.z};
+
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            _origin[axis] = origin_coords[axis];
+            _direction[axis] = (length > 0) ? direction_coords[axis] / length : 0;
+
+            // Visiting child (j ^ mask) for j = 0..7 is front to back, since a
+            // ray only ever flips each child index bit once.
+            if (_direction[axis] < 0)
+            {
+                _direction_mask |= 1 << axis;
+            }
+        }
+    }
+
+    std::optional<float> cast() const
+    {
+        const uint32_t lower[3] = {0, 0, 0};
+        const uint32_t size = LocationCodes::cell_size(0);
+        float t_enter, t_exit;
+
+        if (!intersect(lower, size, t_enter, t_exit))
+        {
+            return std::nullopt;
+        }
+
+        return visit(_accessor.root(), lower, size);
+    }
+
+private:
+
+    bool intersect(const uint32_t lower[3], uint32_t size, float& t_enter, float& t_exit) const
+    {
+        t_enter = -std::numeric_limits<float>::infinity();
+        t_exit = std::numeric_limits<float>::infinity();
+
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            const float low = lower[axis];
+            const float high = low + size;
+
+            if (_direction[axis] == 0)
+            {
+                if (_origin[axis] < low || _origin[axis] >= high)
+                {
+                    return false;
+                }
+                continue;
+            }
+
+            const float t_a = (low - _origin[axis]) / _direction[axis];
+            const float t_b = (high - _origin[axis]) / _direction[axis];
+            t_enter = std::max(t_enter, std::min(t_a, t_b));
+            t_exit = std::min(t_exit, std::max(t_a, t_b));
+        }
+
+        return t_enter <= t_exit && t_exit >= 0 && t_enter <= _max_distance;
+    }
+
+    std::optional<float> visit(Handle handle, const uint32_t lower[3], uint32_t size) const
+    {
+        const NodeType node = _accessor.node(handle);
+        const uint32_t half = size / 2;
+
+        for (int j = 0; j < 8; ++j)
+        {
+            const int i = j ^ _direction_mask;
+            const bool exists = get_child_exists(node, i);
+
+            if (!exists && !get_child_set_if_not_exists(node, i))
+            {
+                continue;
+            }
+
+            const uint32_t child_lower[3] = {
+                lower[0] + ((i & 1) ? half : 0),
+                lower[1] + ((i & 2) ? half : 0),
+                lower[2] + ((i & 4) ? half : 0),
+            };
+
+            float t_enter, t_exit;
+            if (!intersect(child_lower, half, t_enter, t_exit))
+            {
+                continue;
+            }
+
+            if (!exists)
+            {
+                return std::max(t_enter, 0.0f);
+            }
+
+            if (const std::optional<float> hit = visit(_accessor.child(handle, node, i), child_lower, half))
+            {
+                return hit;
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    const Accessor& _accessor;
+    const float _max_distance;
+    float _origin[3];
+    float _direction[3];
+    int _direction_mask;
+};
+
+#endif // _RAYCAST_H_
@@ -0,0 +1,57 @@
+#ifndef _SPARSE_VOXEL_DAG_H_
+#define _SPARSE_VOXEL_DAG_H_
+
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <vector>
+
+#include "octree.h"
+
+// A read-only octree in which identical subtrees are stored once. Nodes are
+// packed into a single word array as [NodeType, child offsets...], with one
+// child offset per existing child in child index order.
+template <typename LocationCode>
+class SparseVoxelDag
+{
+public:
+
+    using LocationCodes = LocationCodesBase<LocationCode>;
+    using LocationCodeType = LocationCode;
+
+    template <typename MapWrapper>
+    explicit SparseVoxelDag(const OctreeBase<LocationCode, MapWrapper>& octree);
+
+    // Reads a DAG previously written with write()
+    explicit SparseVoxelDag(std::istream& is);
+
+    bool is_set(LocationCode location_code) const;
+
+    float get_volume() const;
+
+    // Distance along the ray to the first set region hit, if within max_distance
+    std::optional<float> raycast(const Vertex& origin, const Vertex& direction, float max_distance) const;
+
+    static constexpr size_t get_max_depth() { return LocationCodes::max_depth(); }
+    size_t get_num_nodes() const { return _num_nodes; }
+    size_t get_num_bytes() const { return _data.size() * sizeof(uint32_t); }
+
+    void write(std::ostream& os) const;
+
+private:
+
+    uint32_t child_offset(uint32_t offset, NodeType node, int child_index) const;
+    void validate() const;
+
+    std::vector<uint32_t> _data;
+    uint32_t _root;
+    size_t _num_nodes;
+};
+
+// Converts an octree into a DAG by deduplicating identical subtrees bottom up
+template <typename LocationCode, typename MapWrapper>
+SparseVoxelDag<LocationCode> freeze(const OctreeBase<LocationCode, MapWrapper>& octree);
+
+#include "sparse_voxel_dag.inl.h"
+
+#endif // _SPARSE_VOXEL_DAG_H_
@@ -0,0 +1,259 @@
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "raycast.h"
+#include "sparse_voxel_dag.h"
+
+namespace sparse_voxel_dag_detail
+{
+
+struct WordsHash
+{
+    size_t operator()(const std::vector<uint32_t>& words) const
+    {
+        size_t result = words.size();
+        for (uint32_t word : words)
+        {
+            result ^= word + 0x9e3779b97f4a7c15ull + (result << 6) + (result >> 2);
+        }
+        return result;
+    }
+};
+
+} // namespace sparse_voxel_dag_detail
+
+template <typename LocationCode>
+template <typename MapWrapper>
+SparseVoxelDag<LocationCode>::SparseVoxelDag(const OctreeBase<LocationCode, MapWrapper>& octree) :
+    _root(0),
+    _num_nodes(0)
+{
+    // Post-order traversal: a node's children are all finished (and their
+    // offsets known) by the time it exits, so each node is hashed exactly once.
+    struct Visitor : OctreeVisitor<LocationCode>
+    {
+        Visitor(SparseVoxelDag& dag) : dag(dag), pending(LocationCodes::max_depth() + 1) {}
+
+        void exit_node(LocationCode location_code, NodeType node)
+        {
+            const int depth = LocationCodes::depth(location_code);
+            std::vector<uint32_t> words = {node};
+
+            if (depth < (int)LocationCodes::max_depth())
+            {
+                words.insert(words.end(), pending[depth + 1].begin(), pending[depth + 1].end());
+                pending[depth + 1].clear();
+            }
+
+            const auto result = offsets.emplace(words, (uint32_t)dag._data.size());
+            if (result.second)
+            {
+                dag._data.insert(dag._data.end(), words.begin(), words.end());
+                ++dag._num_nodes;
+            }
+
+            if (depth == 0)
+            {
+                dag._root = result.first->second;
+            }
+            else
+            {
+                pending[depth].push_back(result.first->second);
+            }
+        }
+
+        SparseVoxelDag& dag;
+        std::vector<std::vector<uint32_t>> pending;
+        std::unordered_map<std::vector<uint32_t>, uint32_t, sparse_voxel_dag_detail::WordsHash> offsets;
+    } visitor(*this);
+
+    octree.traverse(visitor);
+    _data.shrink_to_fit();
+}
+
+template <typename LocationCode>
+SparseVoxelDag<LocationCode>::SparseVoxelDag(std::istream& is) :
+    _root(0),
+    _num_nodes(0)
+{
+    uint64_t header[3];
+    is.read(reinterpret_cast<char*>(header), sizeof(header));
+
+    if (!is || header[0] != sizeof(LocationCode))
+    {
+        throw std::runtime_error("Invalid SparseVoxelDag stream");
+    }
+
+    uint64_t size;
+    is.read(reinterpret_cast<char*>(&size), sizeof(size));
+
+    // Every node takes one to nine words and offsets are 32-bit, so anything
+    // else is corrupt and must not drive the allocation below
+    if (!is || size == 0 || size > std::numeric_limits<uint32_t>::max() ||
+        header[2] > size || size > 9 * header[2] || header[1] >= size)
+    {
+        throw std::runtime_error("Invalid SparseVoxelDag stream");
+    }
+
+    _root = header[1];
+    _num_nodes = header[2];
+
+    // Read in bounded chunks, so a size larger than the stream fails on the
+    // short read instead of allocating it all up front
+    constexpr uint64_t chunk_size = 1 << 16;
+
+    while (_data.size() < size && is)
+    {
+        const size_t begin = _data.size();
+        _data.resize(begin + std::min(chunk_size, size - begin));
+        is.read(reinterpret_cast<char*>(_data.data() + begin), (_data.size() - begin) * sizeof(uint32_t));
+    }
+
+    if (!is)
+    {
+        throw std::runtime_error("Truncated SparseVoxelDag stream");
+    }
+
+    validate();
+}
+
+// Checks that the words parse as nodes, children first, with every child
+// offset pointing back at an earlier node, so traversals stay in bounds
+template <typename LocationCode>
+void SparseVoxelDag<LocationCode>::validate() const
+{
+    std::vector<bool> node_starts(_data.size(), false);
+    size_t num_nodes = 0;
+
+    for (size_t offset = 0; offset < _data.size(); ++num_nodes)
+    {
+        const uint32_t node = _data[offset];
+        const size_t end = offset + 1 + bit_count(node & 0xff);
+
+        if (node > std::numeric_limits<NodeType>::max() || end > _data.size())
+        {
+            throw std::runtime_error("Invalid SparseVoxelDag node");
+        }
+
+        for (size_t i = offset + 1; i < end; ++i)
+        {
+            if (_data[i] >= offset || !node_starts[_data[i]])
+            {
+                throw std::runtime_error("Invalid SparseVoxelDag child offset");
+            }
+        }
+
+        node_starts[offset] = true;
+        offset = end;
+    }
+
+    if (num_nodes != _num_nodes || !node_starts[_root])
+    {
+        throw std::runtime_error("Invalid SparseVoxelDag stream");
+    }
+}
+
+template <typename LocationCode>
+void SparseVoxelDag<LocationCode>::write(std::ostream& os) const
+{
+    const uint64_t header[3] = {sizeof(LocationCode), _root, _num_nodes};
+    const uint64_t size = _data.size();
+
+    os.write(reinterpret_cast<const char*>(header), sizeof(header));
+    os.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    os.write(reinterpret_cast<const char*>(_data.data()), size * sizeof(uint32_t));
+}
+
+template <typename LocationCode>
+uint32_t SparseVoxelDag<LocationCode>::child_offset(uint32_t offset, NodeType node, int child_index) const
+{
+    // Children are packed by the popcount of the existing children before them
+    const unsigned preceding = node & 0xff & ((1u << child_index) - 1);
+    return _data[offset + 1 + bit_count(preceding)];
+}
+
+template <typename LocationCode>
+bool SparseVoxelDag<LocationCode>::is_set(LocationCode location_code) const
+{
+    const int depth = LocationCodes::depth(location_code);
+    uint32_t offset = _root;
+    NodeType node = _data[offset];
+
+    if (depth == 0)
+    {
+        return node == 0xff00;
+    }
+
+    for (int level = 0; level < depth; ++level)
+    {
+        const int child_index = LocationCodes::final_child_index(location_code >> 3 * (depth - level - 1));
+
+        if (!get_child_exists(node, child_index))
+        {
+            return get_child_set_if_not_exists(node, child_index);
+        }
+
+        offset = child_offset(offset, node, child_index);
+        node = _data[offset];
+    }
+
+    return false;
+}
+
+template <typename LocationCode>
+float SparseVoxelDag<LocationCode>::get_volume() const
+{
+    // Nodes are stored children first, so one forward pass sees every child's
+    // volume before its parent needs it. Shared subtrees are counted once per
+    // unique node rather than once per occurrence.
+    std::unordered_map<uint32_t, double> volumes;
+    volumes.reserve(_num_nodes);
+
+    for (uint32_t offset = 0; offset < _data.size();)
+    {
+        const NodeType node = _data[offset];
+        double volume = 0;
+
+        for (int i = 0; i < 8; ++i)
+        {
+            if (get_child_exists(node, i))
+            {
+                volume += volumes[child_offset(offset, node, i)] / 8;
+            }
+            else if (get_child_set_if_not_exists(node, i))
+            {
+                volume += 1.0 / 8;
+            }
+        }
+
+        volumes[offset] = volume;
+        offset += 1 + bit_count(node & 0xff);
+    }
+
+    return (float)volumes[_root];
+}
+
+template <typename LocationCode>
+std::optional<float> SparseVoxelDag<LocationCode>::raycast(const Vertex& origin, const Vertex& direction, float max_distance) const
+{
+    struct Accessor
+    {
+        using Handle = uint32_t;
+
+        Handle root() const { return dag._root; }
+        NodeType node(Handle handle) const { return dag._data[handle]; }
+        Handle child(Handle handle, NodeType node, int child_index) const { return dag.child_offset(handle, node, child_index); }
+
+        const SparseVoxelDag& dag;
+    } accessor{*this};
+
+    return RayCaster<LocationCodes, Accessor>(accessor, origin, direction, max_distance).cast();
+}
+
+template <typename LocationCode, typename MapWrapper>
+SparseVoxelDag<LocationCode> freeze(const OctreeBase<LocationCode, MapWrapper>& octree)
+{
+    return SparseVoxelDag<LocationCode>(octree);
+}
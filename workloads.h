@@ -0,0 +1,350 @@
+#ifndef _WORKLOADS_H_
+#define _WORKLOADS_H_
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "location_code.h"
+
+// Seeded synthetic occupancy for benchmarks. Generators return cell indices
+// at a given depth; workload_codes() turns them into a location-code stream
+// in the requested insertion order. The same seed always gives the same cells.
+
+enum class WorkloadOrder { MORTON, SCANLINE };
+
+struct Workload
+{
+    std::string name;
+    uint8_t depth;
+    std::vector<GridPoint> cells; // Cell indices at depth, duplicates allowed
+};
+
+inline const char* to_string(WorkloadOrder order)
+{
+    return order == WorkloadOrder::MORTON ? "morton" : "scanline";
+}
+
+// Morton order sorts by location code, scan-line order by z, then y, then x
+template <typename LocationCodes, typename LocationCode = decltype(LocationCodes::encode(0, 0, 0, 0))>
+std::vector<LocationCode> workload_codes(const Workload& workload, WorkloadOrder order)
+{
+    std::vector<GridPoint> cells = workload.cells;
+
+    if (order == WorkloadOrder::SCANLINE)
+    {
+        std::sort(cells.begin(), cells.end(), [](const GridPoint& a, const GridPoint& b)
+        {
+            return std::tie(a.z, a.y, a.x) < std::tie(b.z, b.y, b.x);
+        });
+    }
+
+    std::vector<LocationCode> codes;
+    codes.reserve(cells.size());
+    for (const GridPoint& cell : cells)
+    {
+        codes.push_back(LocationCodes::encode(workload.depth, cell.x, cell.y, cell.z));
+    }
+
+    if (order == WorkloadOrder::MORTON)
+    {
+        std::sort(codes.begin(), codes.end());
+    }
+
+    return codes;
+}
+
+// Every cell whose centre has sdf(x, y, z) < 0, in cell units at depth
+template <typename Sdf>
+Workload sdf_workload(const std::string& name, uint8_t depth, Sdf sdf)
+{
+    const uint32_t res = 1u << depth;
+    Workload workload{name, depth, {}};
+
+    for (uint32_t z = 0; z < res; ++z)
+    {
+        for (uint32_t y = 0; y < res; ++y)
+        {
+            for (uint32_t x = 0; x < res; ++x)
+            {
+                if (sdf(x + 0.5f, y + 0.5f, z + 0.5f) < 0)
+                {
+                    workload.cells.push_back({x, y, z});
+                }
+            }
+        }
+    }
+
+    return workload;
+}
+
+inline Workload full_grid_workload(uint8_t depth)
+{
+    return sdf_workload("full_grid", depth, [](float, float, float) { return -1.0f; });
+}
+
+inline Workload sphere_workload(uint8_t depth)
+{
+    const float radius = (1u << depth) * 0.5f;
+    return sdf_workload("sphere", depth, [radius](float x, float y, float z)
+    {
+        return std::sqrt((x - radius) * (x - radius) + (y - radius) * (y - radius) + (z - radius) * (z - radius)) - radius;
+    });
+}
+
+// Union of random spheres and axis-aligned boxes
+inline Workload primitives_workload(uint8_t depth, uint32_t seed, int num_primitives=16)
+{
+    const float res = float(1u << depth);
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> position(0, res);
+    std::uniform_real_distribution<float> size(res / 32, res / 6);
+
+    struct Primitive { float x, y, z, size; bool is_box; };
+    std::vector<Primitive> primitives;
+    for (int i = 0; i < num_primitives; ++i)
+    {
+        primitives.push_back({position(rng), position(rng), position(rng), size(rng), i % 2 == 1});
+    }
+
+    return sdf_workload("primitives", depth, [&primitives](float x, float y, float z)
+    {
+        float distance = INFINITY;
+        for (const Primitive& p : primitives)
+        {
+            const float dx = std::abs(x - p.x), dy = std::abs(y - p.y), dz = std::abs(z - p.z);
+            distance = std::min(distance, p.is_box
+                ? std::max({dx, dy, dz}) - p.size
+                : std::sqrt(dx * dx + dy * dy + dz * dz) - p.size);
+        }
+        return distance;
+    });
+}
+
+inline Workload random_sparse_workload(uint8_t depth, uint32_t seed, float occupancy=0.01f)
+{
+    const uint32_t res = 1u << depth;
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<uint32_t> coord(0, res - 1);
+    Workload workload{"random_sparse", depth, {}};
+
+    const size_t count = size_t(occupancy * res * res * res);
+    for (size_t i = 0; i < count; ++i)
+    {
+        workload.cells.push_back({coord(rng), coord(rng), coord(rng)});
+    }
+
+    return workload;
+}
+
+// Floor, ceiling and four walls of a room
+inline Workload planar_surfaces_workload(uint8_t depth)
+{
+    const uint32_t res = 1u << depth;
+    const uint32_t last = res - 1;
+    Workload workload{"planar_surfaces", depth, {}};
+
+    for (uint32_t a = 0; a < res; ++a)
+    {
+        for (uint32_t b = 0; b < res; ++b)
+        {
+            workload.cells.push_back({a, b, 0});
+            workload.cells.push_back({a, b, last});
+            workload.cells.push_back({a, 0, b});
+            workload.cells.push_back({a, last, b});
+            workload.cells.push_back({0, a, b});
+            workload.cells.push_back({last, a, b});
+        }
+    }
+
+    return workload;
+}
+
+// Gaussian blobs around random centres, like objects seen by a scanner
+inline Workload clustered_workload(uint8_t depth, uint32_t seed, int num_clusters=64)
+{
+    const uint32_t res = 1u << depth;
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> centre(0, res);
+    std::normal_distribution<float> offset(0, res / 32.0f);
+    Workload workload{"clustered", depth, {}};
+
+    const size_t points_per_cluster = (size_t)res * res / 4;
+    for (int cluster = 0; cluster < num_clusters; ++cluster)
+    {
+        const float cx = centre(rng), cy = centre(rng), cz = centre(rng);
+
+        for (size_t i = 0; i < points_per_cluster; ++i)
+        {
+            const float x = cx + offset(rng), y = cy + offset(rng), z = cz + offset(rng);
+            if (x >= 0 && x < res && y >= 0 && y < res && z >= 0 && z < res)
+            {
+                workload.cells.push_back({(uint32_t)x, (uint32_t)y, (uint32_t)z});
+            }
+        }
+    }
+
+    return workload;
+}
+
+// Classic 2D gradient noise with a seeded permutation table, in [-1, 1]
+class PerlinNoise
+{
+public:
+
+    explicit PerlinNoise(uint32_t seed)
+    {
+        std::iota(_permutation.begin(), _permutation.begin() + 256, 0);
+        std::shuffle(_permutation.begin(), _permutation.begin() + 256, std::mt19937(seed));
+        std::copy(_permutation.begin(), _permutation.begin() + 256, _permutation.begin() + 256);
+    }
+
+    float operator()(float x, float y) const
+    {
+        const int xi = int(std::floor(x)) & 255, yi = int(std::floor(y)) & 255;
+        const float xf = x - std::floor(x), yf = y - std::floor(y);
+        const float u = fade(xf), v = fade(yf);
+
+        const int aa = _permutation[_permutation[xi] + yi], ab = _permutation[_permutation[xi] + yi + 1];
+        const int ba = _permutation[_permutation[xi + 1] + yi], bb = _permutation[_permutation[xi + 1] + yi + 1];
+
+        const float x0 = lerp(grad(aa, xf, yf), grad(ba, xf - 1, yf), u);
+        const float x1 = lerp(grad(ab, xf, yf - 1), grad(bb, xf - 1, yf - 1), u);
+        return lerp(x0, x1, v);
+    }
+
+private:
+
+    static float fade(float t) { return t * t * t * (t * (t * 6 - 15) + 10); }
+    static float lerp(float a, float b, float t) { return a + t * (b - a); }
+
+    static float grad(int hash, float x, float y)
+    {
+        switch (hash & 3)
+        {
+            case 0: return x + y;
+            case 1: return -x + y;
+            case 2: return x - y;
+            default: return -x - y;
+        }
+    }
+
+    std::array<int, 512> _permutation;
+};
+
+// Solid heightfield terrain from a few octaves of Perlin noise
+inline Workload terrain_workload(uint8_t depth, uint32_t seed, int num_octaves=4)
+{
+    const uint32_t res = 1u << depth;
+    const PerlinNoise noise(seed);
+    Workload workload{"terrain", depth, {}};
+
+    for (uint32_t y = 0; y < res; ++y)
+    {
+        for (uint32_t x = 0; x < res; ++x)
+        {
+            float height = 0, amplitude = 0.5f, frequency = 4.0f / res;
+            for (int octave = 0; octave < num_octaves; ++octave)
+            {
+                height += amplitude * noise(x * frequency, y * frequency);
+                amplitude *= 0.5f;
+                frequency *= 2;
+            }
+
+            const float top = std::clamp((0.5f + 0.5f * height) * res, 1.0f, float(res));
+            for (uint32_t z = 0; z < uint32_t(top); ++z)
+            {
+                workload.cells.push_back({x, y, z});
+            }
+        }
+    }
+
+    return workload;
+}
+
+// Hits of a spinning multi-beam scanner in a noisy room: sparse shells of
+// points around each sensor position, thinning with distance
+inline Workload lidar_workload(uint8_t depth, uint32_t seed, int num_scans=4, int num_beams=32, int num_azimuths=1024)
+{
+    constexpr float pi = 3.14159265358979f;
+    const float res = float(1u << depth);
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> position(res * 0.25f, res * 0.75f);
+    std::normal_distribution<float> range_noise(0, res / 512);
+    const PerlinNoise noise(seed);
+    Workload workload{"lidar", depth, {}};
+
+    for (int scan = 0; scan < num_scans; ++scan)
+    {
+        const float ox = position(rng), oy = position(rng), oz = position(rng);
+
+        for (int beam = 0; beam < num_beams; ++beam)
+        {
+            const float elevation = -0.4f + 0.8f * beam / std::max(1, num_beams - 1);
+
+            for (int azimuth_index = 0; azimuth_index < num_azimuths; ++azimuth_index)
+            {
+                const float azimuth = 2 * pi * azimuth_index / num_azimuths;
+                const float dx = std::cos(elevation) * std::cos(azimuth);
+                const float dy = std::cos(elevation) * std::sin(azimuth);
+                const float dz = std::sin(elevation);
+
+                // Range to the room's bounding box, dented by noise to mimic clutter
+                float range = INFINITY;
+                const float direction[3] = {dx, dy, dz}, origin[3] = {ox, oy, oz};
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    if (direction[axis] != 0)
+                    {
+                        const float wall = direction[axis] > 0 ? res - 1 : 0;
+                        range = std::min(range, (wall - origin[axis]) / direction[axis]);
+                    }
+                }
+                range *= 0.6f + 0.4f * std::abs(noise(azimuth * 4, elevation * 8));
+                range = std::max(0.0f, range + range_noise(rng));
+
+                const float x = ox + dx * range, y = oy + dy * range, z = oz + dz * range;
+                if (x >= 0 && x < res && y >= 0 && y < res && z >= 0 && z < res)
+                {
+                    workload.cells.push_back({(uint32_t)x, (uint32_t)y, (uint32_t)z});
+                }
+            }
+        }
+    }
+
+    return workload;
+}
+
+// Lattice random walks moving to one of the 26 neighbours per step, clamped to the grid
+inline Workload random_walk_workload(uint8_t depth, uint32_t seed, int num_walks=16, size_t num_steps=0)
+{
+    const int64_t last = (int64_t(1) << depth) - 1;
+    num_steps = num_steps ? num_steps : size_t(last + 1) * (last + 1);
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int64_t> start(0, last);
+    std::uniform_int_distribution<int> step(-1, 1);
+    Workload workload{"random_walk", depth, {}};
+
+    for (int walk = 0; walk < num_walks; ++walk)
+    {
+        int64_t x = start(rng), y = start(rng), z = start(rng);
+
+        for (size_t i = 0; i < num_steps; ++i)
+        {
+            workload.cells.push_back({(uint32_t)x, (uint32_t)y, (uint32_t)z});
+            x = std::clamp<int64_t>(x + step(rng), 0, last);
+            y = std::clamp<int64_t>(y + step(rng), 0, last);
+            z = std::clamp<int64_t>(z + step(rng), 0, last);
+        }
+    }
+
+    return workload;
+}
+
+#endif // _WORKLOADS_H_